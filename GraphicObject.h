@@ -6,6 +6,15 @@
 
 using namespace std;
 
+// 释放CPU数组后仍然保留的网格信息
+struct GeometryInfo{
+    unsigned int vertexCount = 0;
+    unsigned int indexCount = 0;
+    unsigned int lineIndexCount = 0;
+    glm::vec3 lower = glm::vec3(0.0f);          // 顶点的包围盒
+    glm::vec3 upper = glm::vec3(0.0f);
+};
+
 class GraphicObject{
 public:
     GraphicObject(){};
@@ -26,6 +35,13 @@ public:
 
     virtual int getInterleavedStride() const = 0;
 
+    // GPU驻留: 数据上传后releaseArrays释放全部CPU数组, 计数和包围盒仍可查询;
+    // 导出等需要顶点时先restoreArrays按原参数重新生成
+    virtual void releaseArrays() = 0;
+    virtual void restoreArrays() = 0;
+    virtual bool hasArrays() const = 0;
+    virtual GeometryInfo getGeometryInfo() const = 0;
+
     virtual int getNo() const = 0;
 
     virtual glm::vec3 getColor() const = 0;
@@ -1,4 +1,4 @@
-QT       += core gui
+QT       += core gui concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -10,22 +10,47 @@ INCLUDEPATH += /usr/local/boost_1_73_0 /usr/local/include/glm
 
 SOURCES += \
     GraphicObject.cpp \
+    bvh.cpp \
     camera.cpp \
     cylinder.cpp \
+    lod.cpp \
     main.cpp \
     mainwindow.cpp \
+    meshcache.cpp \
+    molloader.cpp \
+    moltable.cpp \
     molviewer.cpp \
-    sphere.cpp
+    scenebuffer.cpp \
+    scenecache.cpp \
+    scenegraph.cpp \
+    selection.cpp \
+    sphere.cpp \
+    threadpool.cpp \
+    trajectory.cpp \
+    trajectoryfile.cpp
 
 HEADERS += \
     GraphicObject.h \
+    bvh.h \
     camera.h \
     color_table.h \
     config.h \
     cylinder.h \
+    instances.h \
+    lod.h \
     mainwindow.h \
+    meshcache.h \
+    molloader.h \
+    moltable.h \
     molviewer.h \
-    sphere.h
+    scenebuffer.h \
+    scenecache.h \
+    scenegraph.h \
+    selection.h \
+    sphere.h \
+    threadpool.h \
+    trajectory.h \
+    trajectoryfile.h
 
 
 FORMS += \
@@ -0,0 +1,300 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <cmath>
+
+// 叶子节点中最多的图元数
+const unsigned int MAX_LEAF_SIZE = 8;
+
+///////////////////////////////////////////////////////////////////////////////
+// extract the frustum planes from a view-projection matrix (Gribb/Hartmann)
+///////////////////////////////////////////////////////////////////////////////
+Frustum::Frustum(const glm::mat4& m){
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    planes[0] = row3 + row0;    // left
+    planes[1] = row3 - row0;    // right
+    planes[2] = row3 + row1;    // bottom
+    planes[3] = row3 - row1;    // top
+    planes[4] = row3 + row2;    // near
+    planes[5] = row3 - row2;    // far
+
+    for(int i = 0; i < 6; ++i){
+        float length = glm::length(glm::vec3(planes[i].x, planes[i].y, planes[i].z));
+        planes[i] = planes[i] * (1.0f/length);
+    }
+}
+
+Frustum::Result Frustum::classify(const BoundingBox& box) const{
+    Result result = INSIDE;
+    for(int i = 0; i < 6; ++i){
+        const glm::vec4& p = planes[i];
+        // 沿法线方向最远/最近的两个顶点
+        glm::vec3 positive(p.x >= 0 ? box.upper.x : box.lower.x,
+                           p.y >= 0 ? box.upper.y : box.lower.y,
+                           p.z >= 0 ? box.upper.z : box.lower.z);
+        glm::vec3 negative(p.x >= 0 ? box.lower.x : box.upper.x,
+                           p.y >= 0 ? box.lower.y : box.upper.y,
+                           p.z >= 0 ? box.lower.z : box.upper.z);
+        if(p.x*positive.x + p.y*positive.y + p.z*positive.z + p.w < 0)
+            return OUTSIDE;
+        if(p.x*negative.x + p.y*negative.y + p.z*negative.z + p.w < 0)
+            result = INTERSECT;
+    }
+    return result;
+}
+
+bool Frustum::contains(const glm::vec3& center, float radius) const{
+    for(int i = 0; i < 6; ++i){
+        const glm::vec4& p = planes[i];
+        if(p.x*center.x + p.y*center.y + p.z*center.z + p.w < -radius)
+            return false;
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// top-down build, median split along the longest axis of the centroid bounds
+///////////////////////////////////////////////////////////////////////////////
+void Bvh::build(const vector<BoundingBox>& boxes){
+    clear();
+    if(boxes.empty())
+        return;
+
+    unsigned int count = (unsigned int)boxes.size();
+    indices.resize(count);
+    centers.resize(count);
+    for(unsigned int i = 0; i < count; ++i){
+        indices[i] = i;
+        centers[i] = boxes[i].getCenter();
+    }
+
+    nodes.reserve(2*(count/MAX_LEAF_SIZE+1));
+    BvhNode root;
+    root.first = 0;
+    root.count = count;
+    nodes.push_back(root);
+
+    vector<unsigned int> stack;
+    stack.push_back(0);
+    while(!stack.empty()){
+        unsigned int node_index = stack.back();
+        stack.pop_back();
+
+        unsigned int first = nodes[node_index].first;
+        unsigned int n = nodes[node_index].count;
+        BoundingBox box, center_box;
+        for(unsigned int i = first; i < first+n; ++i){
+            box.expand(boxes[indices[i]]);
+            center_box.expand(centers[indices[i]]);
+        }
+        nodes[node_index].box = box;
+        if(n <= MAX_LEAF_SIZE)
+            continue;
+
+        glm::vec3 extent = center_box.getExtent();
+        int axis = 0;
+        if(extent.y > extent.x) axis = 1;
+        if(extent.z > extent[axis]) axis = 2;
+
+        unsigned int half = n/2;
+        const vector<glm::vec3>& c = centers;
+        nth_element(indices.begin()+first, indices.begin()+first+half, indices.begin()+first+n,
+                    [&c, axis](unsigned int a, unsigned int b){ return c[a][axis] < c[b][axis]; });
+
+        // 子节点总在父节点之后, refit时逆序遍历即可自底向上
+        BvhNode left, right;
+        left.first = first;
+        left.count = half;
+        right.first = first+half;
+        right.count = n-half;
+        nodes[node_index].left = (unsigned int)nodes.size();
+        nodes.push_back(left);
+        nodes.push_back(right);
+
+        stack.push_back(nodes[node_index].left);
+        stack.push_back(nodes[node_index].left+1);
+    }
+    vector<glm::vec3>().swap(centers);
+}
+
+void Bvh::refit(const vector<BoundingBox>& boxes){
+    for(size_t n = nodes.size(); n-- > 0;){
+        BvhNode& node = nodes[n];
+        BoundingBox box;
+        if(node.isLeaf()){
+            for(unsigned int i = node.first; i < node.first+node.count; ++i)
+                box.expand(boxes[indices[i]]);
+        }else{
+            box = nodes[node.left].box;
+            box.expand(nodes[node.left+1].box);
+        }
+        node.box = box;
+    }
+}
+
+bool Bvh::assign(vector<BvhNode>& nodes, vector<unsigned int>& indices, size_t primitive_count){
+    for(unsigned int index: indices){
+        if(index >= primitive_count)
+            return false;
+    }
+    vector<unsigned int> depth(nodes.size(), 0);
+    for(size_t n = 0; n < nodes.size(); ++n){
+        const BvhNode& node = nodes[n];
+        if(size_t(node.first) + node.count > indices.size())
+            return false;
+        if(node.isLeaf())
+            continue;
+        if(node.left <= n || size_t(node.left) + 1 >= nodes.size() || depth[n] + 2 >= BVH_STACK_SIZE)
+            return false;
+        depth[node.left] = max(depth[node.left], depth[n] + 1);
+        depth[node.left+1] = max(depth[node.left+1], depth[n] + 1);
+    }
+    this->nodes.swap(nodes);
+    this->indices.swap(indices);
+    return true;
+}
+
+void Bvh::clear(){
+    nodes.clear();
+    indices.clear();
+}
+
+void Bvh::cull(const Frustum& frustum, vector<unsigned int>& visible) const{
+    if(nodes.empty())
+        return;
+
+    unsigned int stack[BVH_STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while(top > 0){
+        const BvhNode& node = nodes[stack[--top]];
+        Frustum::Result result = frustum.classify(node.box);
+        if(result == Frustum::OUTSIDE)
+            continue;
+
+        // 完全在视锥内或已到叶子: 整段图元直接输出
+        if(result == Frustum::INSIDE || node.isLeaf()){
+            visible.insert(visible.end(), indices.begin()+node.first, indices.begin()+node.first+node.count);
+            continue;
+        }
+        stack[top++] = node.left;
+        stack[top++] = node.left+1;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// exact ray queries for picking
+///////////////////////////////////////////////////////////////////////////////
+Ray::Ray(const glm::vec3& origin, const glm::vec3& direction):
+    origin(origin), direction(glm::normalize(direction)){
+    inverse = glm::vec3(1.0f) / this->direction;
+}
+
+bool intersect_Box(const Ray& ray, const BoundingBox& box, float t_max, float& t){
+    glm::vec3 t0 = (box.lower - ray.origin) * ray.inverse;
+    glm::vec3 t1 = (box.upper - ray.origin) * ray.inverse;
+    glm::vec3 t_near = glm::min(t0, t1);
+    glm::vec3 t_far = glm::max(t0, t1);
+    float enter = max(max(t_near.x, t_near.y), max(t_near.z, 0.0f));
+    float exit = min(min(t_far.x, t_far.y), min(t_far.z, t_max));
+    t = enter;
+    return enter <= exit;
+}
+
+bool intersect_Sphere(const Ray& ray, const glm::vec3& center, float radius, float& t){
+    glm::vec3 oc = ray.origin - center;
+    float b = glm::dot(oc, ray.direction);
+    float c = glm::dot(oc, oc) - radius*radius;
+    float h = b*b - c;
+    if(h < 0.0f)
+        return false;
+    h = sqrt(h);
+    t = -b - h;
+    if(t < 0.0f)
+        t = -b + h;
+    return t >= 0.0f;
+}
+
+bool intersect_Capsule(const Ray& ray, const glm::vec3& start, const glm::vec3& end, float radius, float& t){
+    // 先与无限长圆柱求交, 交点落在两端之间即为侧面; 否则与较近一端的半球求交
+    glm::vec3 axis = end - start;
+    glm::vec3 oa = ray.origin - start;
+    float axis_axis = glm::dot(axis, axis);
+    float axis_dir = glm::dot(axis, ray.direction);
+    float axis_oa = glm::dot(axis, oa);
+    float dir_oa = glm::dot(ray.direction, oa);
+    float a = axis_axis - axis_dir*axis_dir;
+    float b = axis_axis*dir_oa - axis_oa*axis_dir;
+    float c = axis_axis*glm::dot(oa, oa) - axis_oa*axis_oa - radius*radius*axis_axis;
+    float h = b*b - a*c;
+    if(h >= 0.0f && a > 0.0f){
+        float side = (-b - sqrt(h)) / a;
+        float y = axis_oa + side*axis_dir;
+        if(side >= 0.0f && y > 0.0f && y < axis_axis){
+            t = side;
+            return true;
+        }
+    }
+    bool hit = false;
+    float cap;
+    if(intersect_Sphere(ray, start, radius, cap)){
+        t = cap;
+        hit = true;
+    }
+    if(intersect_Sphere(ray, end, radius, cap) && (!hit || cap < t)){
+        t = cap;
+        hit = true;
+    }
+    return hit;
+}
+
+int Bvh::raycast(const Ray& ray, const function<bool(unsigned int, float&)>& hit, float& t) const{
+    int nearest = -1;
+    float entry;
+    if(nodes.empty() || !intersect_Box(ray, nodes[0].box, t, entry))
+        return nearest;
+
+    // 栈中保存节点及其入射距离, 出栈时已有更近的命中则跳过
+    unsigned int stack[BVH_STACK_SIZE];
+    float stack_entry[BVH_STACK_SIZE];
+    int top = 0;
+    stack[top] = 0;
+    stack_entry[top++] = entry;
+    while(top > 0){
+        --top;
+        if(stack_entry[top] > t)
+            continue;
+        const BvhNode& node = nodes[stack[top]];
+        if(node.isLeaf()){
+            for(unsigned int i = node.first; i < node.first+node.count; ++i){
+                if(hit(indices[i], t))
+                    nearest = int(indices[i]);
+            }
+            continue;
+        }
+        // 近的子节点后入栈, 先被访问
+        float left_entry, right_entry;
+        bool left_hit = intersect_Box(ray, nodes[node.left].box, t, left_entry);
+        bool right_hit = intersect_Box(ray, nodes[node.left+1].box, t, right_entry);
+        if(left_hit && right_hit && left_entry < right_entry){
+            stack[top] = node.left+1;
+            stack_entry[top++] = right_entry;
+            stack[top] = node.left;
+            stack_entry[top++] = left_entry;
+        }else{
+            if(left_hit){
+                stack[top] = node.left;
+                stack_entry[top++] = left_entry;
+            }
+            if(right_hit){
+                stack[top] = node.left+1;
+                stack_entry[top++] = right_entry;
+            }
+        }
+    }
+    return nearest;
+}
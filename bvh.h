@@ -0,0 +1,94 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <functional>
+#include <vector>
+#include <glm/glm.hpp>
+
+using namespace std;
+
+struct BoundingBox{
+    glm::vec3 lower = glm::vec3( 1e30f);
+    glm::vec3 upper = glm::vec3(-1e30f);
+
+    void expand(const glm::vec3& point)         { lower = glm::min(lower, point); upper = glm::max(upper, point); }
+    void expand(const BoundingBox& box)         { lower = glm::min(lower, box.lower); upper = glm::max(upper, box.upper); }
+    glm::vec3 getCenter() const                 { return 0.5f*(lower+upper); }
+    glm::vec3 getExtent() const                 { return upper-lower; }
+};
+
+// 视锥体的六个平面, 法线指向内侧
+class Frustum{
+public:
+    enum Result{ OUTSIDE, INTERSECT, INSIDE };
+
+    Frustum() {}
+    explicit Frustum(const glm::mat4& view_projection);
+
+    Result classify(const BoundingBox& box) const;
+    bool contains(const glm::vec3& center, float radius) const;
+    const glm::vec4* getPlanes() const          { return planes; }
+
+private:
+    glm::vec4 planes[6];
+};
+
+// 射线origin + t*direction, direction为单位向量
+struct Ray{
+    Ray(const glm::vec3& origin, const glm::vec3& direction);
+
+    glm::vec3 origin;
+    glm::vec3 direction;
+    glm::vec3 inverse;                          // 1/direction, 供包围盒的slab测试
+};
+
+// 射线与包围盒/球/胶囊体(两端为半球的圆柱)求交, t为最近的非负交点参数
+// 包围盒只接受t < t_max的交点; 射线起点在球内时t为出射点
+bool intersect_Box(const Ray& ray, const BoundingBox& box, float t_max, float& t);
+bool intersect_Sphere(const Ray& ray, const glm::vec3& center, float radius, float& t);
+bool intersect_Capsule(const Ray& ray, const glm::vec3& start, const glm::vec3& end, float radius, float& t);
+
+// cull/raycast的遍历栈容量, 树深不能超过它减一
+const unsigned int BVH_STACK_SIZE = 64;
+
+// 叶子节点: left==0, 图元为indices[first, first+count)
+// 内部节点: 子节点为left和left+1, [first, first+count)是整棵子树的图元区间
+struct BvhNode{
+    BoundingBox box;
+    unsigned int first = 0;
+    unsigned int count = 0;
+    unsigned int left = 0;
+
+    bool isLeaf() const                         { return left == 0; }
+};
+
+class Bvh{
+public:
+    Bvh() {}
+
+    void build(const vector<BoundingBox>& boxes);
+    void refit(const vector<BoundingBox>& boxes);      // 拓扑不变, 只更新包围盒
+    // 接管已构建好的数据(如从缓存读入); 先检查图元编号小于primitive_count, 区间和子节点不越界,
+    // 子节点排在父节点之后(refit倒序依赖这一点)且树深在遍历栈容量以内, 不合法时不接管并返回false
+    bool assign(vector<BvhNode>& nodes, vector<unsigned int>& indices, size_t primitive_count);
+    void clear();
+
+    // 把视锥内(或与之相交)的图元编号追加到visible
+    void cull(const Frustum& frustum, vector<unsigned int>& visible) const;
+
+    // 由近及远遍历与射线相交的节点, 对叶子中的图元调用hit(primitive, t)做精确求交
+    // hit在交点比t更近时更新t并返回true; 返回最近命中的图元, 没有命中返回-1
+    // t传入时是最大距离, 比它远的节点直接跳过
+    int raycast(const Ray& ray, const function<bool(unsigned int, float&)>& hit, float& t) const;
+
+    bool empty() const                          { return nodes.empty(); }
+    const vector<BvhNode>& getNodes() const     { return nodes; }
+    const vector<unsigned int>& getIndices() const  { return indices; }
+
+private:
+    vector<BvhNode> nodes;
+    vector<unsigned int> indices;
+    vector<glm::vec3> centers;                  // 只在build时使用
+};
+
+#endif // BVH_H
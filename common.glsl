@@ -0,0 +1,42 @@
+// declarations shared by every "#version 430" shader, inserted after the version line
+// by MolViewer::createShader/createComputeShader; edit the encodings here only
+
+// current frame of atom positions, indexed by the atom id
+// same layout as AtomPosition in instances.h, position is local to the atom's scene graph node
+struct AtomPosition
+{
+    vec3 position;
+    uint node;
+};
+layout (std430, binding = 6) readonly buffer Positions { AtomPosition positions[]; };
+
+// world matrix of every scene graph node (molecule, chain, residue)
+layout (std430, binding = 2) readonly buffer NodeMatrices { mat4 nodeMatrices[]; };
+
+// one bit per atom, indexed by the atom id (see SelectionSet)
+layout (std430, binding = 5) readonly buffer Selection { uint selection[]; };
+
+vec3 atomPosition(uint id)
+{
+    AtomPosition atom = positions[id];
+    return vec3(nodeMatrices[atom.node] * vec4(atom.position, 1.0));
+}
+
+bool selected(uint id)
+{
+    return ((selection[id >> 5] >> (id & 31u)) & 1u) != 0u;
+}
+
+// set when the merged mesh buffer uses the packed layout (see VertexFormat in scenebuffer.h),
+// aNormal.xy then holds an octahedral encoding and aNormal.z is 0
+uniform bool packedNormals;
+
+vec3 decodeNormal(vec3 n)
+{
+    if(!packedNormals)
+        return n;
+    vec3 v = vec3(n.xy, 1.0 - abs(n.x) - abs(n.y));
+    if(v.z < 0.0)
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(v);
+}
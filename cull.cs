@@ -0,0 +1,151 @@
+#version 430 core
+layout (local_size_x = 64) in;
+
+// same layouts as AtomInstance/BondInstance in instances.h
+struct AtomInstance
+{
+    vec3 center;
+    float radius;
+    vec3 color;
+    uint id;
+};
+
+struct BondInstance
+{
+    vec3 start;
+    float radius;
+    vec3 end;
+    float offset;
+    vec3 color;
+    uint first;
+    uint second;
+    uint id;
+};
+
+// same layout as DrawElementsIndirectCommand in scenebuffer.h
+struct DrawCommand
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    uint baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer AtomInstances { AtomInstance atoms[]; };
+layout (std430, binding = 1) readonly buffer BondInstances { BondInstance bonds[]; };
+layout (std430, binding = 3) buffer Commands { DrawCommand commands[]; };
+layout (std430, binding = 4) writeonly buffer Visible { uint visible[]; };
+
+uniform uint instanceCount;
+uniform uint commandFirst;          // first of the LOD_LEVELS commands of this instance type
+uniform bool cullBonds;             // instances are bonds instead of atoms
+
+// frustum of the current frame, normals pointing inwards
+uniform vec4 planes[6];
+
+// LOD selection, same rule as LodSelector::select
+uniform vec3 eye;
+uniform vec3 forward;
+uniform float pixelScale;
+uniform float thresholds[3];
+
+// depth pyramid of the previous frame
+uniform bool useHiZ;
+uniform mat4 previousViewProjection;
+uniform sampler2D hiZ;
+uniform int hiZLevels;
+
+bool insideFrustum(vec3 lower, vec3 upper)
+{
+    for (int i = 0; i < 6; ++i) {
+        vec3 positive = mix(lower, upper, greaterThanEqual(planes[i].xyz, vec3(0.0)));
+        if (dot(planes[i].xyz, positive) + planes[i].w < 0.0)
+            return false;
+    }
+    return true;
+}
+
+bool occluded(vec3 lower, vec3 upper)
+{
+    // screen rectangle and nearest depth of the box as seen by the previous frame
+    vec2 rectMin = vec2(1.0);
+    vec2 rectMax = vec2(0.0);
+    float nearest = 1.0;
+    for (int i = 0; i < 8; ++i) {
+        vec3 corner = vec3((i & 1) != 0 ? upper.x : lower.x,
+                           (i & 2) != 0 ? upper.y : lower.y,
+                           (i & 4) != 0 ? upper.z : lower.z);
+        vec4 clip = previousViewProjection * vec4(corner, 1.0);
+        if (clip.w <= 0.0)
+            return false;               // crosses the near plane
+        vec3 ndc = clip.xyz / clip.w;
+        vec2 uv = ndc.xy * 0.5 + 0.5;
+        rectMin = min(rectMin, uv);
+        rectMax = max(rectMax, uv);
+        nearest = min(nearest, ndc.z * 0.5 + 0.5);
+    }
+    rectMin = clamp(rectMin, vec2(0.0), vec2(1.0));
+    rectMax = clamp(rectMax, vec2(0.0), vec2(1.0));
+
+    // pick the level where the rectangle spans at most 2x2 texels
+    vec2 size = (rectMax - rectMin) * vec2(textureSize(hiZ, 0));
+    int level = clamp(int(ceil(log2(max(max(size.x, size.y), 1.0)))), 0, hiZLevels - 1);
+    ivec2 levelSize = textureSize(hiZ, level);
+    ivec2 texelMin = clamp(ivec2(rectMin * vec2(levelSize)), ivec2(0), levelSize - 1);
+    ivec2 texelMax = clamp(ivec2(rectMax * vec2(levelSize)), ivec2(0), levelSize - 1);
+
+    float farthest = max(max(texelFetch(hiZ, texelMin, level).r,
+                             texelFetch(hiZ, ivec2(texelMax.x, texelMin.y), level).r),
+                         max(texelFetch(hiZ, ivec2(texelMin.x, texelMax.y), level).r,
+                             texelFetch(hiZ, texelMax, level).r));
+    return nearest > farthest;
+}
+
+uint selectLevel(vec3 center, float radius)
+{
+    float depth = dot(center - eye, forward);
+    if (depth <= radius)
+        return 0u;
+    float pixelRadius = radius * pixelScale / depth;
+    for (uint l = 0u; l < 3u; ++l) {
+        if (pixelRadius > thresholds[l])
+            return l;
+    }
+    return 3u;
+}
+
+void main()
+{
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= instanceCount)
+        return;
+
+    // bounds follow the position stream, same boxes as atom_Bounds/bond_Bounds
+    vec3 lower, upper;
+    float lodRadius;
+    if (cullBonds) {
+        BondInstance bond = bonds[index];
+        vec3 start = atomPosition(bond.first);
+        vec3 end = atomPosition(bond.second);
+        float margin = bond.radius + abs(bond.offset);
+        lower = min(start, end) - vec3(margin);
+        upper = max(start, end) + vec3(margin);
+        lodRadius = bond.radius;
+    } else {
+        AtomInstance atom = atoms[index];
+        vec3 center = atomPosition(atom.id);
+        lower = center - vec3(atom.radius);
+        upper = center + vec3(atom.radius);
+        lodRadius = atom.radius;
+    }
+    if (!insideFrustum(lower, upper))
+        return;
+    if (useHiZ && occluded(lower, upper))
+        return;
+
+    // append to the list of the chosen level; each level owns instanceCount slots
+    uint level = selectLevel(0.5 * (lower + upper), lodRadius);
+    uint slot = atomicAdd(commands[commandFirst + level].instanceCount, 1u);
+    visible[commands[commandFirst + level].baseInstance + slot] = index;
+}
@@ -0,0 +1,48 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in uint aInstance;    // index written by cull.cs
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec3 Color;
+flat out uint PickId;       // written to the ID buffer, see pickid.fs
+
+// same layout as BondInstance in instances.h
+struct BondInstance
+{
+    vec3 start;
+    float radius;
+    vec3 end;
+    float offset;
+    vec3 color;
+    uint first;
+    uint second;
+    uint id;
+};
+
+layout (std430, binding = 1) readonly buffer BondInstances { BondInstance bonds[]; };
+
+void main()
+{
+    BondInstance bond = bonds[aInstance];
+    vec3 start = atomPosition(bond.first);
+    vec3 end = atomPosition(bond.second);
+    vec3 axis = end - start;
+    float height = length(axis);
+    vec3 direction = axis / height;
+
+    // same frame as instancedcylinder.vs
+    vec3 worldUp = abs(direction.y) > 0.999 ? vec3(1.0, 0.0, 0.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(worldUp, direction));
+    vec3 up = cross(direction, right);
+    mat3 rotation = mat3(right, up, direction);
+
+    vec3 center = 0.5 * (start + end) - right * bond.offset;
+    FragPos = center + rotation * vec3(aPos.xy * bond.radius, aPos.z * height);
+    Normal = rotation * decodeNormal(aNormal);
+    Color = selected(bond.first) && selected(bond.second) ? vec3(1.0) : bond.color;
+    PickId = (bond.id + 1u) | 0x80000000u;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
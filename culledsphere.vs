@@ -0,0 +1,31 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in uint aInstance;    // index written by cull.cs
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec3 Color;
+flat out uint PickId;       // written to the ID buffer, see pickid.fs
+
+// same layout as AtomInstance in instances.h
+struct AtomInstance
+{
+    vec3 center;
+    float radius;
+    vec3 color;
+    uint id;
+};
+
+layout (std430, binding = 0) readonly buffer AtomInstances { AtomInstance atoms[]; };
+
+void main()
+{
+    AtomInstance atom = atoms[aInstance];
+    FragPos = atomPosition(atom.id) + aPos * atom.radius;
+    Normal = decodeNormal(aNormal);
+    Color = selected(atom.id) ? vec3(1.0) : atom.color;
+    PickId = atom.id + 1u;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -30,6 +30,9 @@ Cylinder::Cylinder(glm::vec3 start_point, glm::vec3 end_point, float baseRadius,
 ///////////////////////////////////////////////////////////////////////////////
 void Cylinder::set(float baseRadius, float topRadius, float height, int sectors,
                    int stacks, bool smooth){
+    this->released = false;
+    this->placement = glm::mat3(1.0f);
+    this->placementOffset = glm::vec3(0.0f);
     this->baseRadius = baseRadius;
     this->topRadius = topRadius;
     this->height = height;
@@ -110,6 +113,53 @@ void Cylinder::printSelf() const {
 ///////////////////////////////////////////////////////////////////////////////
 // dealloc vectors
 ///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+// GPU-resident mode: free every CPU array but keep the counts and bounds,
+// restoreArrays() rebuilds from the parameters and reapplies tweak/move
+///////////////////////////////////////////////////////////////////////////////
+void Cylinder::releaseArrays(){
+    if(released)
+        return;
+    GeometryInfo info = getGeometryInfo();
+    clearArrays();
+    vector<float>().swap(interleavedVertices);
+    vector<float>().swap(unitCircleVertices);
+    releasedInfo = info;
+    released = true;
+}
+
+void Cylinder::restoreArrays(){
+    if(!released)
+        return;
+    glm::mat3 model = placement;
+    glm::vec3 offset = placementOffset;
+    set(baseRadius, topRadius, height, sectorCount, stackCount, smooth);
+    for(int i=0; i< vertices.size()/3; ++i){
+        glm::vec3 vertex = model*glm::vec3(vertices[i*3], vertices[i*3 + 1], vertices[i*3 + 2]) + offset;
+        vertices[i*3] = vertex.x;
+        vertices[i*3 + 1] = vertex.y;
+        vertices[i*3 + 2] = vertex.z;
+    }
+    placement = model;
+    placementOffset = offset;
+    buildInterleavedVertices();
+}
+
+GeometryInfo Cylinder::getGeometryInfo() const{
+    if(released)
+        return releasedInfo;
+    GeometryInfo info;
+    info.vertexCount = getVertexCount();
+    info.indexCount = getIndexCount();
+    info.lineIndexCount = getLineIndexCount();
+    for(size_t i = 0; i + 2 < vertices.size(); i += 3){
+        glm::vec3 vertex(vertices[i], vertices[i+1], vertices[i+2]);
+        info.lower = i == 0 ? vertex : glm::min(info.lower, vertex);
+        info.upper = i == 0 ? vertex : glm::max(info.upper, vertex);
+    }
+    return info;
+}
+
 void Cylinder::clearArrays(){
     vector<float>().swap(vertices);
     vector<float>().swap(normals);
@@ -587,6 +637,8 @@ void Cylinder::tweak(glm::vec3 direction){      // direction方向向量
         vertices[i*3 + 1] = Transformed.y;
         vertices[i*3 + 2] = Transformed.z;
     }
+    placement = model*placement;
+    placementOffset = model*placementOffset;
     buildInterleavedVertices();
 }
 
@@ -596,6 +648,7 @@ void Cylinder::move(glm::vec3 target){
         vertices[i*3 + 1] += target.y;
         vertices[i*3 + 2] += target.z;
     }
+    placementOffset += target;
 
     buildInterleavedVertices();
 };
@@ -40,11 +40,11 @@ public:
     void setSmooth(bool smooth);
 
     // for vertex data
-    unsigned int getVertexCount() const     { return (unsigned int)vertices.size() / 3; }
+    unsigned int getVertexCount() const     { return released ? releasedInfo.vertexCount : (unsigned int)vertices.size() / 3; }
     unsigned int getNormalCount() const     { return (unsigned int)normals.size() / 3; }
     unsigned int getTexCoordCount() const   { return (unsigned int)texCoords.size() / 2; }
-    unsigned int getIndexCount() const      { return (unsigned int)indices.size(); }
-    unsigned int getLineIndexCount() const  { return (unsigned int)lineIndices.size(); }
+    unsigned int getIndexCount() const      { return released ? releasedInfo.indexCount : (unsigned int)indices.size(); }
+    unsigned int getLineIndexCount() const  { return released ? releasedInfo.lineIndexCount : (unsigned int)lineIndices.size(); }
     unsigned int getTriangleCount() const   { return getIndexCount() / 3; }
     unsigned int getVertexSize() const      { return (unsigned int)vertices.size() * sizeof(float); }
     unsigned int getNormalSize() const      { return (unsigned int)normals.size() * sizeof(float); }
@@ -61,11 +61,17 @@ public:
     unsigned int getInterleavedVertexCount() const  { return getVertexCount(); }    // # of vertices
     unsigned int getInterleavedVertexSize() const   { return (unsigned int)interleavedVertices.size() * sizeof(unsigned int); }    // # of bytes
     int getInterleavedStride() const                { return interleavedStride; }   // should be 32 bytes
-    const float* getInterleavedVertices() const     { return &interleavedVertices[0]; }
+    const float* getInterleavedVertices() const     { return interleavedVertices.data(); }
+
+    // GPU驻留模式
+    void releaseArrays();
+    void restoreArrays();
+    bool hasArrays() const                  { return !released; }
+    GeometryInfo getGeometryInfo() const;
 
     // for indices of base/top/side parts
-    unsigned int getBaseIndexCount() const  { return ((unsigned int)indices.size() - baseIndex) / 2; }
-    unsigned int getTopIndexCount() const   { return ((unsigned int)indices.size() - baseIndex) / 2; }
+    unsigned int getBaseIndexCount() const  { return (getIndexCount() - baseIndex) / 2; }
+    unsigned int getTopIndexCount() const   { return (getIndexCount() - baseIndex) / 2; }
     unsigned int getSideIndexCount() const  { return baseIndex; }
     unsigned int getBaseStartIndex() const  { return baseIndex; }
     unsigned int getTopStartIndex() const   { return topIndex; }
@@ -122,6 +128,14 @@ private:
     int interleavedStride = 8;                  // # of bytes to hop to the next vertex (should be 32 bytes)
 
     glm::vec3 color;
+
+    // set()之后tweak/move累计的变换: v' = placement * v + placementOffset, 重新生成时再施加一次
+    glm::mat3 placement = glm::mat3(1.0f);
+    glm::vec3 placementOffset = glm::vec3(0.0f);
+
+    // 释放CPU数组后的计数和包围盒
+    bool released = false;
+    GeometryInfo releasedInfo;
 };
 
 #endif // CYLINDER_H
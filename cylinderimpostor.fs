@@ -0,0 +1,77 @@
+#version 420 core
+out vec4 FragColor;
+
+in vec3 ViewPos;
+flat in vec3 ViewStart;
+flat in vec3 ViewEnd;
+flat in float Radius;
+flat in vec3 Color;
+
+// ray (from the view space origin) against a cylinder with flat caps,
+// returns the hit distance or -1.0 and the surface normal
+float intersectCappedCylinder(vec3 rayDir, vec3 a, vec3 b, float radius, out vec3 normal)
+{
+    vec3 ba = b - a;
+    vec3 oc = -a;
+    float baba = dot(ba, ba);
+    float bard = dot(ba, rayDir);
+    float baoc = dot(ba, oc);
+    float k2 = baba - bard * bard;
+    float k1 = baba * dot(oc, rayDir) - baoc * bard;
+    float k0 = baba * dot(oc, oc) - baoc * baoc - radius * radius * baba;
+    float h = k1 * k1 - k2 * k0;
+    if(h < 0.0)
+        return -1.0;
+    h = sqrt(h);
+
+    // side
+    float t = (-k1 - h) / k2;
+    float y = baoc + t * bard;
+    if(y > 0.0 && y < baba){
+        normal = (oc + t * rayDir - ba * y / baba) / radius;
+        return t;
+    }
+
+    // caps
+    t = ((y < 0.0 ? 0.0 : baba) - baoc) / bard;
+    if(abs(k1 + k2 * t) < h){
+        normal = ba * sign(y) / sqrt(baba);
+        return t;
+    }
+    return -1.0;
+}
+
+void main()
+{
+    vec3 rayDir = normalize(ViewPos);
+    vec3 norm;
+    float t = intersectCappedCylinder(rayDir, ViewStart, ViewEnd, Radius, norm);
+    if(t < 0.0)
+        discard;
+
+    vec3 hit = rayDir * t;
+    vec4 clipPos = projection * vec4(hit, 1.0);
+    gl_FragDepth = 0.5 * (gl_DepthRange.diff * (clipPos.z / clipPos.w) + gl_DepthRange.near + gl_DepthRange.far);
+
+    // same Phong terms as instancedlighted.fs, evaluated in view space
+    vec3 lightViewPos = vec3(view * vec4(lightPos.xyz, 1.0));
+
+    // ambient
+    float ambientStrength = 0.1;
+    vec3 ambient = ambientStrength * lightColor.rgb;
+
+    // diffuse
+    vec3 lightDir = normalize(lightViewPos - hit);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = diff * lightColor.rgb;
+
+    // specular
+    float specularStrength = 0.5;
+    vec3 viewDir = normalize(-hit);
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+    vec3 specular = specularStrength * spec * lightColor.rgb;
+
+    vec3 result = (ambient + diffuse + specular) * Color;
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,51 @@
+#version 430 core
+layout (location = 2) in vec4 aStartRadius;
+layout (location = 3) in vec4 aEndOffset;
+layout (location = 4) in vec3 aColor;
+layout (location = 5) in uvec2 aAtoms;     // atom ids of both ends
+layout (location = 6) in uint aBondId;
+
+out vec3 ViewPos;
+flat out vec3 ViewStart;
+flat out vec3 ViewEnd;
+flat out float Radius;
+flat out vec3 Color;
+flat out uint PickId;       // written to the ID buffer, see pickid.fs
+
+// quad corners of a triangle strip, indexed by gl_VertexID
+const vec2 corners[4] = vec2[4](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(-1.0, 1.0), vec2(1.0, 1.0));
+
+void main()
+{
+    // same side offset as instancedcylinder.vs, so double and aromatic bonds match the mesh mode
+    vec3 start = atomPosition(aAtoms.x);
+    vec3 end = atomPosition(aAtoms.y);
+    vec3 direction = normalize(end - start);
+    vec3 worldUp = abs(direction.y) > 0.999 ? vec3(1.0, 0.0, 0.0) : vec3(0.0, 1.0, 0.0);
+    vec3 shift = -normalize(cross(worldUp, direction)) * aEndOffset.w;
+
+    ViewStart = vec3(view * vec4(start + shift, 1.0));
+    ViewEnd = vec3(view * vec4(end + shift, 1.0));
+    Radius = aStartRadius.w;
+    Color = selected(aAtoms.x) && selected(aAtoms.y) ? vec3(1.0) : aColor;
+    PickId = (aBondId + 1u) | 0x80000000u;
+
+    // camera-facing quad stretched along the projected bond axis, wide enough for the end caps
+    vec3 center = 0.5 * (ViewStart + ViewEnd);
+    vec3 toEye = normalize(-center);
+    vec3 axis = ViewEnd - ViewStart;
+    vec3 along = axis - dot(axis, toEye) * toEye;
+    float halfLength = 0.5 * length(along);
+    vec3 u;
+    if(halfLength > 1e-4)
+        u = along / (2.0 * halfLength);
+    else    // bond points at the camera, only the cap is visible
+        u = abs(toEye.y) < 0.999 ? normalize(cross(toEye, vec3(0.0, 1.0, 0.0))) : vec3(1.0, 0.0, 0.0);
+    vec3 v = normalize(cross(toEye, u));
+
+    float pad = Radius * 1.5;
+    vec2 corner = corners[gl_VertexID];
+    ViewPos = center + u * corner.x * (halfLength + pad) + v * corner.y * pad + toEye * Radius;
+
+    gl_Position = projection * vec4(ViewPos, 1.0);
+}
@@ -0,0 +1,10 @@
+// per-frame constants shared by every vertex and fragment shader, inserted after the
+// version line by MolViewer::createShader; same std140 layout as FrameUniforms in molviewer.h
+layout (std140, binding = 0) uniform FrameUniforms
+{
+    mat4 view;
+    mat4 projection;
+    vec4 lightPos;
+    vec4 lightColor;
+    vec4 viewPos;
+};
@@ -0,0 +1,35 @@
+#version 430 core
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// level 0 copies the depth buffer, every other level keeps the farthest depth
+// of the texels it covers in the level above (including the extra row/column
+// of odd-sized levels)
+uniform sampler2D source;
+uniform int sourceLevel;
+layout (r32f, binding = 0) writeonly uniform image2D destination;
+uniform bool copyDepth;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(destination);
+    if (texel.x >= size.x || texel.y >= size.y)
+        return;
+
+    if (copyDepth) {
+        imageStore(destination, texel, vec4(texelFetch(source, texel, 0).r));
+        return;
+    }
+
+    ivec2 sourceSize = textureSize(source, sourceLevel);
+    ivec2 base = texel * 2;
+    ivec2 extent = ivec2(sourceSize.x > size.x * 2 ? 3 : 2, sourceSize.y > size.y * 2 ? 3 : 2);
+    float farthest = 0.0;
+    for (int y = 0; y < extent.y; ++y) {
+        for (int x = 0; x < extent.x; ++x) {
+            ivec2 p = min(base + ivec2(x, y), sourceSize - 1);
+            farthest = max(farthest, texelFetch(source, p, sourceLevel).r);
+        }
+    }
+    imageStore(destination, texel, vec4(farthest));
+}
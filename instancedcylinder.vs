@@ -0,0 +1,37 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec4 aStartRadius;
+layout (location = 3) in vec4 aEndOffset;
+layout (location = 4) in vec3 aColor;
+layout (location = 5) in uvec2 aAtoms;     // atom ids of both ends
+layout (location = 6) in uint aBondId;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec3 Color;
+flat out uint PickId;       // written to the ID buffer, see pickid.fs
+
+void main()
+{
+    vec3 start = atomPosition(aAtoms.x);
+    vec3 end = atomPosition(aAtoms.y);
+    vec3 axis = end - start;
+    float height = length(axis);
+    vec3 direction = axis / height;
+
+    // same frame as Cylinder::tweak, with a fallback for bonds parallel to the y axis
+    vec3 worldUp = abs(direction.y) > 0.999 ? vec3(1.0, 0.0, 0.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(worldUp, direction));
+    vec3 up = cross(direction, right);
+    mat3 rotation = mat3(right, up, direction);
+
+    // unit cylinder: radius 1, z in [-0.5, 0.5]; offset splits double bonds sideways
+    vec3 center = 0.5 * (start + end) - right * aEndOffset.w;
+    FragPos = center + rotation * vec3(aPos.xy * aStartRadius.w, aPos.z * height);
+    Normal = rotation * decodeNormal(aNormal);
+    Color = selected(aAtoms.x) && selected(aAtoms.y) ? vec3(1.0) : aColor;
+    PickId = (aBondId + 1u) | 0x80000000u;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
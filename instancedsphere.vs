@@ -0,0 +1,22 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec4 aCenterRadius;
+layout (location = 3) in vec3 aColor;
+layout (location = 4) in uint aId;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec3 Color;
+flat out uint PickId;       // written to the ID buffer, see pickid.fs
+
+void main()
+{
+    // unit sphere scaled by the instance radius and moved to the atom center
+    FragPos = atomPosition(aId) + aPos * aCenterRadius.w;
+    Normal = decodeNormal(aNormal);
+    Color = selected(aId) ? vec3(1.0) : aColor;
+    PickId = aId + 1u;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,37 @@
+#ifndef INSTANCES_H
+#define INSTANCES_H
+
+#include <glm/glm.hpp>
+
+// 每个原子的实例数据(32 bytes), 布局与instancedsphere.vs的实例属性一致
+// 着色器从位置流(binding 6)按id取原子中心, center只供CPU端剔除和拾取使用
+struct AtomInstance{
+    glm::vec3 center;
+    float radius;
+    glm::vec3 color;
+    unsigned int id;            // 在atom_instances中的下标, 着色器据此查询SelectionSet的位
+};
+
+// 位置流中每个原子的一项(16 bytes), 与着色器中的AtomPosition一致
+// position是所属场景图节点内的局部坐标, 着色器再乘以该节点的世界矩阵(binding 2)
+struct AtomPosition{
+    glm::vec3 position;
+    unsigned int node;          // SceneGraph中的节点下标
+};
+
+// 每根键的实例数据(64 bytes), 布局与instancedcylinder.vs的实例属性一致
+// 键的朝向由顶点着色器根据两个端点计算, 双键/芳香键拆成两条带正负offset的实例
+// 着色器按first/second从位置流取端点, 播放轨迹时实例数据不必重新上传
+struct BondInstance{
+    glm::vec3 start;
+    float radius;
+    glm::vec3 end;
+    float offset;
+    glm::vec3 color;
+    unsigned int first;         // 两端原子在atom_instances中的下标
+    unsigned int second;
+    unsigned int id;            // 在bond_instances中的下标, 写入ID缓冲供拾取
+    unsigned int padding[2];
+};
+
+#endif // INSTANCES_H
@@ -1,18 +1,17 @@
 #version 420 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec3 aColor;
 
 out vec3 FragPos;
 out vec3 Normal;
-
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+out vec3 Color;
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
+    FragPos = aPos;
     Normal = aNormal;
+    Color = aColor;
 
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
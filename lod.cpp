@@ -0,0 +1,22 @@
+#include "lod.h"
+
+#include <cmath>
+
+void LodSelector::setView(glm::vec3 eye, glm::vec3 forward, float fovy_radians, float viewport_height){
+    this->eye = eye;
+    this->forward = glm::normalize(forward);
+    this->pixelScale = viewport_height * 0.5f / tanf(fovy_radians * 0.5f);
+}
+
+int LodSelector::select(glm::vec3 center, float radius) const{
+    float depth = glm::dot(center - eye, forward);
+    if(depth <= radius)                 // 相机在物体内部或紧贴物体
+        return 0;
+
+    float pixel_radius = radius * pixelScale / depth;
+    for(int l = 0; l < LOD_LEVELS-1; ++l){
+        if(pixel_radius > LOD_PIXEL_THRESHOLDS[l])
+            return l;
+    }
+    return LOD_LEVELS-1;
+}
@@ -0,0 +1,83 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+using namespace std;
+
+#define LOD_LEVELS 4
+
+// 各级别的细分参数, 级别0最精细
+const int SPHERE_LOD_SECTORS[LOD_LEVELS]   = {32, 16, 10, 6};
+const int SPHERE_LOD_STACKS[LOD_LEVELS]    = {16,  8,  5, 3};
+const int CYLINDER_LOD_SECTORS[LOD_LEVELS] = {24, 16,  8, 5};
+
+// 投影半径(像素)大于阈值i时使用级别i
+const float LOD_PIXEL_THRESHOLDS[LOD_LEVELS-1] = {24.0f, 8.0f, 3.0f};
+
+// 按屏幕上的投影半径选择细分级别
+class LodSelector{
+public:
+    LodSelector() {}
+
+    void setView(glm::vec3 eye, glm::vec3 forward, float fovy_radians, float viewport_height);
+    int select(glm::vec3 center, float radius) const;
+    float getPixelScale() const     { return pixelScale; }
+
+private:
+    glm::vec3 eye = glm::vec3(0.0f);
+    glm::vec3 forward = glm::vec3(0.0f, 0.0f, -1.0f);
+    float pixelScale = 1.0f;        // 距离为1处, 1个单位长度对应的像素数
+};
+
+// 每个级别在重排后实例数组中的区间
+struct LodBuckets{
+    unsigned int first[LOD_LEVELS];
+    unsigned int count[LOD_LEVELS];
+};
+
+// 未参与分组(被剔除)的实例在slots中的标记
+const unsigned int LOD_CULLED = 0xFFFFFFFFu;
+
+///////////////////////////////////////////////////////////////////////////////
+// counting sort of the candidate instances by LOD level
+// sorted receives the candidates grouped by level, slots[i] is the new position
+// of instances[i] or LOD_CULLED if i is not a candidate; center_of/radius_of
+// extract the bounding sphere of one instance
+///////////////////////////////////////////////////////////////////////////////
+template<class Instance, class CenterFn, class RadiusFn>
+LodBuckets bucket_ByLod(const vector<Instance>& instances, const vector<unsigned int>& candidates,
+                        const LodSelector& selector, CenterFn center_of, RadiusFn radius_of,
+                        vector<Instance>& sorted, vector<unsigned int>& slots){
+    vector<unsigned char> levels(candidates.size());
+    LodBuckets buckets;
+    for(int l = 0; l < LOD_LEVELS; ++l)
+        buckets.count[l] = 0;
+
+    for(size_t c = 0; c < candidates.size(); ++c){
+        const Instance& instance = instances[candidates[c]];
+        int level = selector.select(center_of(instance), radius_of(instance));
+        levels[c] = (unsigned char)level;
+        ++buckets.count[level];
+    }
+
+    unsigned int offset = 0;
+    unsigned int next[LOD_LEVELS];
+    for(int l = 0; l < LOD_LEVELS; ++l){
+        buckets.first[l] = offset;
+        next[l] = offset;
+        offset += buckets.count[l];
+    }
+
+    sorted.resize(candidates.size());
+    slots.assign(instances.size(), LOD_CULLED);
+    for(size_t c = 0; c < candidates.size(); ++c){
+        unsigned int slot = next[levels[c]]++;
+        sorted[slot] = instances[candidates[c]];
+        slots[candidates[c]] = slot;
+    }
+    return buckets;
+}
+
+#endif // LOD_H
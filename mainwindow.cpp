@@ -10,6 +10,61 @@ MainWindow::MainWindow(QWidget *parent)
     viewer = new MolViewer();
     viewer->resize(WIDTH, HEIGHT);
     mainLayout->addWidget(viewer);
+    connect(viewer, &MolViewer::drawStatsChanged, [this](const QString& message){ ui->statusbar->showMessage(message); });
+
+    // 鼠标下的原子/键, 与绘制统计分开显示
+    hoverLabel = new QLabel;
+    ui->statusbar->addPermanentWidget(hoverLabel);
+    connect(viewer, &MolViewer::hoverChanged, hoverLabel, &QLabel::setText);
+
+    // 后台载入的进度条和取消按钮, 只在载入期间显示
+    loadProgress = new QProgressBar;
+    loadProgress->setRange(0, 100);
+    loadProgress->setMaximumWidth(200);
+    cancelLoad = new QPushButton(tr("Cancel"));
+    ui->statusbar->addPermanentWidget(loadProgress);
+    ui->statusbar->addPermanentWidget(cancelLoad);
+    hide_LoadProgress();
+
+    MolLoader* loader = viewer->getLoader();
+    connect(loader, &MolLoader::progressChanged, this, &MainWindow::show_LoadProgress);
+    connect(loader, &MolLoader::loaded, this, &MainWindow::hide_LoadProgress);
+    connect(loader, &MolLoader::canceled, this, &MainWindow::hide_LoadProgress);
+    connect(loader, &MolLoader::failed, [this](const QString& message){
+        hide_LoadProgress();
+        messagebox.setText(message);
+        messagebox.exec();
+    });
+    connect(cancelLoad, &QPushButton::clicked, loader, &MolLoader::cancel);
+
+    // 轨迹播放条: 播放/暂停和拖动定位, 只在多帧的文件中显示
+    playbackBar = new QWidget;
+    QHBoxLayout* playbackLayout = new QHBoxLayout(playbackBar);
+    playbackLayout->setContentsMargins(0, 0, 0, 0);
+    playButton = new QPushButton(tr("Play"));
+    playButton->setCheckable(true);
+    frameSlider = new QSlider(Qt::Horizontal);
+    frameLabel = new QLabel;
+    playbackLayout->addWidget(playButton);
+    playbackLayout->addWidget(frameSlider);
+    playbackLayout->addWidget(frameLabel);
+    mainLayout->addWidget(playbackBar, 1, 0);
+    reset_Playback(1);
+
+    connect(playButton, &QPushButton::toggled, [this](bool checked){
+        if(checked)
+            viewer->play();
+        else
+            viewer->pause();
+        playButton->setText(checked ? tr("Pause") : tr("Play"));
+    });
+    connect(frameSlider, &QSlider::valueChanged, [this](int frame){
+        if(frame != viewer->getCurrentFrame())
+            viewer->setFrame(frame);
+    });
+    connect(frameSlider, &QSlider::sliderPressed, [this](){ playButton->setChecked(false); });
+    connect(viewer, &MolViewer::trajectoryChanged, this, &MainWindow::reset_Playback);
+    connect(viewer, &MolViewer::frameChanged, this, &MainWindow::show_Frame);
 }
 
 MainWindow::~MainWindow(){
@@ -22,12 +77,55 @@ void MainWindow::on_actionopen_triggered(){
     if (fileName.isEmpty()){
         messagebox.setText("No file found!");
         messagebox.exec();
+        return;
     }
-    viewer->setMolFilePath(fileName.toStdString());
-    viewer->update();
+    viewer->setMolFilePath(fileName.toStdString());     // 后台载入, 界面保持响应
 }
 
 void MainWindow::on_actionadd_triggered(){
+    // 给已载入的结构添加MD轨迹, 原子顺序须与结构文件一致
+    if(viewer->getAtomCount() == 0){
+        messagebox.setText("Open a structure before adding a trajectory!");
+        messagebox.exec();
+        return;
+    }
+    QString trajectoryName = QFileDialog::getOpenFileName(this, tr("Add Trajectory"), home, tr("trajectory (*.dcd *.xtc)"));
+    if(trajectoryName.isEmpty())
+        return;
+    ui->statusbar->showMessage(tr("indexing %1").arg(trajectoryName));
+    viewer->getLoader()->loadTrajectory(trajectoryName, viewer->getAtomCount());
+}
+
+void MainWindow::on_actionimpostor_toggled(bool checked){
+    viewer->setRenderMode(checked ? IMPOSTOR_MODE : MESH_MODE);
+}
+
+void MainWindow::on_actiongpuculling_toggled(bool checked){
+    viewer->setCullMode(checked ? GPU_CULLING : CPU_CULLING);
+}
+
+void MainWindow::show_LoadProgress(int percent, const QString& stage){
+    loadProgress->setValue(percent);
+    loadProgress->show();
+    cancelLoad->show();
+    ui->statusbar->showMessage(stage);
+}
+
+void MainWindow::hide_LoadProgress(){
+    loadProgress->hide();
+    cancelLoad->hide();
+}
+
+void MainWindow::reset_Playback(int frame_count){
+    playButton->setChecked(false);
+    frameSlider->setRange(0, frame_count-1);
+    frameSlider->setValue(0);
+    show_Frame(0);
+    playbackBar->setVisible(frame_count > 1);
+}
 
+void MainWindow::show_Frame(int frame){
+    frameSlider->setValue(frame);
+    frameLabel->setText(QString("%1/%2").arg(frame+1).arg(frameSlider->maximum()+1));
 }
 
@@ -5,6 +5,11 @@
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QGridLayout>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QSlider>
 #include <FileParsers/FileParsers.h>
 #include <GraphMol/ROMol.h>
 
@@ -30,12 +35,29 @@ private slots:
 
     void on_actionadd_triggered();
 
+    void on_actionimpostor_toggled(bool checked);
+
+    void on_actiongpuculling_toggled(bool checked);
+
+    void show_LoadProgress(int percent, const QString& stage);
+    void hide_LoadProgress();
+
+    void reset_Playback(int frame_count);
+    void show_Frame(int frame);
+
 private:
     Ui::MainWindow *ui;
     QGridLayout* mainLayout;
     QMessageBox messagebox;
     QString fileName;
     MolViewer* viewer;
+    QLabel* hoverLabel;
+    QProgressBar* loadProgress;
+    QPushButton* cancelLoad;
+    QWidget* playbackBar;
+    QPushButton* playButton;
+    QSlider* frameSlider;
+    QLabel* frameLabel;
     QString home = getenv("HOME");
 };
 #endif // MAINWINDOW_H
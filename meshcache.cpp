@@ -0,0 +1,72 @@
+#include "meshcache.h"
+
+#include "cylinder.h"
+#include "sphere.h"
+
+#include <tuple>
+
+bool MeshKey::operator<(const MeshKey& other) const{
+    return tie(shape, radius, sectorCount, stackCount, smooth) < tie(other.shape, other.radius, other.sectorCount, other.stackCount, other.smooth);
+}
+
+MeshCache& MeshCache::instance(){
+    static MeshCache cache;
+    return cache;
+}
+
+shared_ptr<GraphicObject> MeshCache::find(const MeshKey& key){
+    // 调用者持有lock; 交出去的网格总带着CPU数组
+    auto found = meshes.find(key);
+    if(found == meshes.end())
+        return nullptr;
+    shared_ptr<GraphicObject> mesh = found->second.lock();
+    if(!mesh)
+        meshes.erase(found);
+    else if(!mesh->hasArrays())
+        mesh->restoreArrays();
+    return mesh;
+}
+
+shared_ptr<const GraphicObject> MeshCache::sphere(float radius, int sectorCount, int stackCount, bool smooth){
+    MeshKey key = {MESH_SPHERE, radius, sectorCount, stackCount, smooth};
+    lock_guard<mutex> guard(lock);
+    shared_ptr<GraphicObject> mesh = find(key);
+    if(!mesh){
+        mesh = make_shared<Sphere>(0, radius, sectorCount, stackCount, glm::vec3(0.0f), glm::vec3(0.0f), smooth);
+        meshes[key] = mesh;
+    }
+    return mesh;
+}
+
+shared_ptr<const GraphicObject> MeshCache::cylinder(float radius, int sectorCount, int stackCount, bool smooth){
+    MeshKey key = {MESH_CYLINDER, radius, sectorCount, stackCount, smooth};
+    lock_guard<mutex> guard(lock);
+    shared_ptr<GraphicObject> mesh = find(key);
+    if(!mesh){
+        mesh = make_shared<Cylinder>(radius, radius, 1.0f, sectorCount, stackCount, glm::vec3(0.0f), smooth);
+        meshes[key] = mesh;
+    }
+    return mesh;
+}
+
+void MeshCache::releaseArrays(const shared_ptr<const GraphicObject>& mesh){
+    // 缓存里的网格都是自己创建的, 按地址找到可修改的句柄
+    lock_guard<mutex> guard(lock);
+    for(const auto& entry: meshes){
+        shared_ptr<GraphicObject> cached = entry.second.lock();
+        if(cached && cached.get() == mesh.get()){
+            cached->releaseArrays();
+            return;
+        }
+    }
+}
+
+size_t MeshCache::size(){
+    lock_guard<mutex> guard(lock);
+    size_t alive = 0;
+    for(const auto& entry: meshes){
+        if(!entry.second.expired())
+            ++alive;
+    }
+    return alive;
+}
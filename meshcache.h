@@ -0,0 +1,51 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "GraphicObject.h"
+
+using namespace std;
+
+// 可缓存的网格形状; 圆柱为高1, 两端半径相同, 沿z轴
+enum MeshShape{
+    MESH_SPHERE,
+    MESH_CYLINDER
+};
+
+struct MeshKey{
+    MeshShape shape;
+    float radius;
+    int sectorCount;
+    int stackCount;
+    bool smooth;
+
+    bool operator<(const MeshKey& other) const;
+};
+
+// 细分参数相同的网格只生成一份, 以只读的共享句柄交给使用者, 每个原子/键只保存变换和颜色(见instances.h)
+// 缓存只持有弱引用: 最后一个句柄释放后网格随之释放, 再次请求时重新生成
+// 上传到GPU后可以releaseArrays只留计数; 之后再请求同一网格时先重新生成CPU数组
+class MeshCache{
+public:
+    MeshCache() {}
+
+    static MeshCache& instance();
+
+    shared_ptr<const GraphicObject> sphere(float radius, int sectorCount, int stackCount, bool smooth = true);
+    shared_ptr<const GraphicObject> cylinder(float radius, int sectorCount, int stackCount, bool smooth = true);
+
+    void releaseArrays(const shared_ptr<const GraphicObject>& mesh);
+
+    size_t size();                              // 仍然存活的网格数
+
+private:
+    shared_ptr<GraphicObject> find(const MeshKey& key);
+
+    mutex lock;
+    map<MeshKey, weak_ptr<GraphicObject>> meshes;
+};
+
+#endif // MESHCACHE_H
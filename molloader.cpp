@@ -0,0 +1,388 @@
+#include "molloader.h"
+
+#include <QtConcurrent/QtConcurrent>
+
+#include <map>
+#include <exception>
+
+#include "color_table.h"
+#include "scenecache.h"
+#include "threadpool.h"
+
+typedef MiniRDKit::Bond::BondType BondType;
+
+// 按原子序数确定显示半径与颜色
+static void atom_Style(int atomic_num, float& radius, glm::vec3& color){
+    if(atomic_num>9){
+        radius = 0.36f; color = GREY31;
+    }else if(atomic_num==9){
+        radius = 0.32f; color = CYAN;
+    }else if(atomic_num==8){
+        radius = 0.28f; color = BLUE;
+    }else if(atomic_num==7){
+        radius = 0.24f; color = GOLD1;
+    }else if(atomic_num==6){
+        radius = 0.2f; color = RED;
+    }else{
+        radius = 0.1f; color = GREEN;
+    }
+}
+
+// 每种画法生成的键实例数, 与build_Keys一致
+static int key_Count(BondType bondtype){
+    return bondtype == MiniRDKit::Bond::DOUBLE ? 2 : 1;
+}
+
+static void build_Keys(BondType bondtype, const AtomInstance& end_atom, const AtomInstance& start_atom, BondInstance* bonds){
+    // 双键拆成两条沿垂直方向偏移±0.05的细键, 偏移方向在着色器中计算; 只写bonds, 可在工作线程中调用
+    glm::vec3 start_point = start_atom.center;
+    glm::vec3 end_point = end_atom.center;
+    if(bondtype == MiniRDKit::Bond::DOUBLE){
+        bonds[0] = {start_point, 0.025f, end_point, 0.05f, RED, start_atom.id, end_atom.id, {0, 0, 0}};
+        bonds[1] = {start_point, 0.025f, end_point, -0.05f, BLUE, start_atom.id, end_atom.id, {0, 0, 0}};
+    }else{
+        bonds[0] = {start_point, 0.05f, end_point, 0.0f, WRITE, start_atom.id, end_atom.id, {0, 0, 0}};
+    }
+}
+
+// 键的画法: 双键画成两条细键, 芳香键沿环单双交替, 其余画成单键
+// aromatic_map记录已经连着双键的芳香原子, 结果依赖键的遍历顺序
+static BondType key_Type(BondType bond_type, int start_atom_idx, int end_atom_idx, map<int, bool>& aromatic_map){
+    if(bond_type == MiniRDKit::Bond::DOUBLE)
+        return MiniRDKit::Bond::DOUBLE;
+    if(bond_type != MiniRDKit::Bond::AROMATIC)
+        return MiniRDKit::Bond::SINGLE;
+
+    auto start_atom = aromatic_map.find(start_atom_idx);
+    auto end_atom = aromatic_map.find(end_atom_idx);
+
+    if(start_atom == aromatic_map.end() && end_atom == aromatic_map.end()){
+        aromatic_map.insert({start_atom_idx, false});
+        aromatic_map.insert({end_atom_idx, false});
+        return MiniRDKit::Bond::SINGLE;
+    }else if(start_atom == aromatic_map.end() && end_atom->second){
+        aromatic_map.insert({start_atom_idx, false});
+        return MiniRDKit::Bond::SINGLE;
+    }else if(start_atom == aromatic_map.end() && !end_atom->second){
+        aromatic_map.insert({start_atom_idx, true});
+        aromatic_map[end_atom_idx] = true;
+        return MiniRDKit::Bond::DOUBLE;
+    }else if(end_atom == aromatic_map.end() && start_atom->second){
+        aromatic_map.insert({end_atom_idx, false});
+        return MiniRDKit::Bond::SINGLE;
+    }else if(end_atom == aromatic_map.end() && !start_atom->second){
+        aromatic_map.insert({end_atom_idx, true});
+        aromatic_map[start_atom_idx] = true;
+        return MiniRDKit::Bond::DOUBLE;
+    }else if(start_atom->second || end_atom->second){
+        aromatic_map[start_atom_idx] = true;
+        aromatic_map[end_atom_idx] = true;
+        return MiniRDKit::Bond::SINGLE;
+    }else{
+        aromatic_map[start_atom_idx] = true;
+        aromatic_map[end_atom_idx] = true;
+        return MiniRDKit::Bond::DOUBLE;
+    }
+}
+
+BoundingBox atom_Bounds(const AtomInstance& atom){
+    BoundingBox box;
+    box.lower = atom.center - glm::vec3(atom.radius);
+    box.upper = atom.center + glm::vec3(atom.radius);
+    return box;
+}
+
+BoundingBox bond_Bounds(const BondInstance& bond){
+    // 偏移的双键整体平移了|offset|, 包围盒一并放大
+    glm::vec3 margin(bond.radius + fabs(bond.offset));
+    BoundingBox box;
+    box.lower = glm::min(bond.start, bond.end) - margin;
+    box.upper = glm::max(bond.start, bond.end) + margin;
+    return box;
+}
+
+MolLoader::MolLoader(QObject *parent): QObject(parent){
+    qRegisterMetaType<QSharedPointer<MolScene>>("QSharedPointer<MolScene>");
+    qRegisterMetaType<shared_ptr<Trajectory>>("shared_ptr<Trajectory>");
+    // 信号由工作线程发出, 自动以队列方式送到本对象所在的GUI线程
+    connect(this, &MolLoader::jobProgress, this, &MolLoader::report_Progress);
+    connect(this, &MolLoader::jobFinished, this, &MolLoader::finish_Job);
+    connect(this, &MolLoader::trajectoryFinished, this, &MolLoader::finish_Trajectory);
+}
+
+MolLoader::~MolLoader(){
+    cancel();
+    for(QFuture<void>& job: jobs)
+        job.waitForFinished();
+}
+
+void MolLoader::load(const QString& path){
+    cancel();
+    int job = ++generation;
+    ++trajectory_generation;
+    shared_ptr<atomic<bool>> cancelled = make_shared<atomic<bool>>(false);
+    cancel_flag = cancelled;
+
+    for(int i = jobs.size()-1; i >= 0; --i){
+        if(jobs[i].isFinished())
+            jobs.removeAt(i);
+    }
+    jobs.append(QtConcurrent::run([this, path, job, cancelled](){ run_Job(path, job, *cancelled); }));
+}
+
+void MolLoader::loadTrajectory(const QString& path, size_t atom_count){
+    int job = ++trajectory_generation;
+    for(int i = jobs.size()-1; i >= 0; --i){
+        if(jobs[i].isFinished())
+            jobs.removeAt(i);
+    }
+    jobs.append(QtConcurrent::run([this, path, atom_count, job](){
+        QString error;
+        shared_ptr<Trajectory> trajectory = open_Trajectory(path, atom_count, &error);
+        emit trajectoryFinished(job, trajectory, error);
+    }));
+}
+
+void MolLoader::finish_Trajectory(int job, shared_ptr<Trajectory> trajectory, const QString& error){
+    if(job != trajectory_generation)
+        return;
+    if(!trajectory)
+        emit failed(error);
+    else
+        emit trajectoryLoaded(trajectory);
+}
+
+void MolLoader::cancel(){
+    if(!cancel_flag)
+        return;
+    *cancel_flag = true;
+    cancel_flag.reset();
+    ++generation;           // 已经排队的进度和结果都会被丢弃
+    emit canceled();
+}
+
+void MolLoader::report_Progress(int job, int percent, const QString& stage){
+    if(job == generation)
+        emit progressChanged(percent, stage);
+}
+
+void MolLoader::finish_Job(int job, QSharedPointer<MolScene> scene, const QString& error){
+    if(job != generation)
+        return;
+    cancel_flag.reset();
+    if(!error.isEmpty())
+        emit failed(error);
+    else
+        emit loaded(scene);
+}
+
+static unsigned char bond_Order(BondType bond_type){
+    switch(bond_type){
+    case MiniRDKit::Bond::DOUBLE:   return BOND_DOUBLE;
+    case MiniRDKit::Bond::TRIPLE:   return BOND_TRIPLE;
+    case MiniRDKit::Bond::AROMATIC: return BOND_AROMATIC;
+    default:                        return BOND_SINGLE;
+    }
+}
+
+// MiniRDKit的分子一次线性遍历转成原子/键表; 第一个构象给出坐标
+// 有多个构象时所有构象依次写入frames, 返回构象数
+static size_t mol_ToTables(MiniRDKit::RWMol* mol, AtomTable& atoms, BondTable& bonds, vector<float>& frames){
+    size_t atom_count = 0;
+    for(auto i = mol->beginAtoms(); i != mol->endAtoms(); ++i)
+        ++atom_count;
+    atoms.resize(atom_count);
+    for(auto i = mol->beginAtoms(); i != mol->endAtoms(); ++i){
+        unsigned int idx = (*i)->getIdx();
+        if(idx >= atom_count)
+            continue;
+        atoms.atomic_number[idx] = (unsigned char)(*i)->getAtomicNum();
+        atoms.serial[idx] = idx+1;
+        atoms.chain[idx] = ' ';
+    }
+
+    size_t conformer_count = 0;
+    for(auto i = mol->beginConformers(); i != mol->endConformers(); ++i){
+        const MiniRDKit::POINT3D_VECT& points = ((*i).get())->getPositions();
+        if(points.size() != atom_count)
+            continue;
+        for(size_t a = 0; a < atom_count; ++a){
+            if(conformer_count == 0){
+                atoms.x[a] = points[a].x;
+                atoms.y[a] = points[a].y;
+                atoms.z[a] = points[a].z;
+            }
+            frames.push_back(points[a].x);
+            frames.push_back(points[a].y);
+            frames.push_back(points[a].z);
+        }
+        ++conformer_count;
+    }
+    if(conformer_count < 2)
+        frames.clear();
+
+    bonds.clear();
+    for(auto bond = mol->beginBonds(); bond != mol->endBonds(); ++bond){
+        bonds.first.push_back((*bond)->getBeginAtomIdx());
+        bonds.second.push_back((*bond)->getEndAtomIdx());
+        bonds.order.push_back(bond_Order((*bond)->getBondType()));
+    }
+    return conformer_count;
+}
+
+// 原子实例直接取自原子表的各列
+static void build_AtomInstances(const AtomTable& table, vector<AtomInstance>& atom_instances){
+    atom_instances.resize(table.size());
+    ThreadPool::instance().parallelFor(0, table.size(), 4096, [&](size_t first, size_t last){
+        for(size_t i = first; i < last; ++i){
+            AtomInstance& atom = atom_instances[i];
+            atom.center = glm::vec3(table.x[i], table.y[i], table.z[i]);
+            atom_Style(table.atomic_number[i], atom.radius, atom.color);
+            atom.id = i;
+        }
+    });
+}
+
+// 每根键写入的实例数是确定的, 前缀和给出各自的输出位置, 再并行生成实例
+static void build_BondInstances(const vector<AtomInstance>& atom_instances, const vector<unsigned int>& key_start,
+                                const vector<unsigned int>& key_end, const vector<BondType>& key_types,
+                                vector<BondInstance>& bond_instances){
+    vector<unsigned int> key_first(key_types.size()+1, 0);
+    for(size_t i = 0; i < key_types.size(); ++i)
+        key_first[i+1] = key_first[i] + key_Count(key_types[i]);
+    bond_instances.resize(key_first.back());
+    ThreadPool::instance().parallelFor(0, key_types.size(), 4096, [&](size_t first, size_t last){
+        for(size_t i = first; i < last; ++i){
+            build_Keys(key_types[i], atom_instances[key_end[i]], atom_instances[key_start[i]], &bond_instances[key_first[i]]);
+            for(unsigned int k = key_first[i]; k < key_first[i+1]; ++k)
+                bond_instances[k].id = k;
+        }
+    });
+}
+
+void MolLoader::run_Job(const QString& path, int job, const atomic<bool>& cancelled){
+    // 每个阶段开始前检查取消标志; 单个阶段内部(如MiniRDKit解析)无法中途打断
+    auto progress = [&](int percent, const char* stage){
+        emit jobProgress(job, percent, QString(stage));
+        return !cancelled;
+    };
+
+    QSharedPointer<MolScene> scene(new MolScene);
+    scene->path = path;
+    string file = path.toStdString();
+    string suffix = file.size() >= 4 ? file.substr(file.size()-4) : "";
+    vector<AtomInstance>& atom_instances = scene->atom_instances;
+    vector<BondInstance>& bond_instances = scene->bond_instances;
+
+    // 之前打开过且文件未变: 直接读缓存, 不再解析和构建
+    if(!progress(0, "reading cache"))
+        return;
+    if(read_SceneCache(path, *scene)){
+        scene->scene_graph.build(scene->atom_table);
+        if(!progress(100, "loaded from cache"))
+            return;
+        emit jobFinished(job, scene, QString());
+        return;
+    }
+
+    if(!progress(0, "parsing"))
+        return;
+    // PDB/mol2先走只为显示服务的快速读取, 读不了的再交给MiniRDKit并转成同样的表
+    bool from_table = false;
+    if(suffix == ".pdb")
+        from_table = read_PdbTable(path, scene->atom_table, scene->bond_table);
+    else if(suffix == "mol2")
+        from_table = read_Mol2Table(path, scene->atom_table, scene->bond_table);
+
+    vector<float> frames;
+    size_t frame_count = 0;
+    if(!from_table){
+        try{
+            if(suffix == ".mol"){
+                scene->mol = MiniRDKit::MolFileToMol(file);
+            }else if(suffix == "mol2"){
+                scene->mol = MiniRDKit::Mol2FileToMol(file);
+            }else if(suffix == ".pdb"){
+                scene->mol = MiniRDKit::PDBFileToMol(file);
+            }
+        }catch(const std::exception& e){
+            emit jobFinished(job, QSharedPointer<MolScene>(), QString("failed to read %1: %2").arg(path, e.what()));
+            return;
+        }
+        if(scene->mol == nullptr){
+            emit jobFinished(job, QSharedPointer<MolScene>(), QString("failed to read %1").arg(path));
+            return;
+        }
+        frame_count = mol_ToTables(scene->mol, scene->atom_table, scene->bond_table, frames);
+    }
+
+    // PDB往往只给配体写CONECT, 其余的键按坐标推断后与已有的键合并
+    if(suffix == ".pdb" && (from_table || scene->bond_table.size() == 0)){
+        if(!progress(30, "perceiving bonds"))
+            return;
+        perceive_Bonds(scene->atom_table, scene->bond_table);
+    }
+
+    if(!progress(40, "building atoms"))
+        return;
+    build_AtomInstances(scene->atom_table, atom_instances);
+
+    if(!progress(60, "building bonds"))
+        return;
+    // 芳香键的单双交替依赖遍历顺序, 先串行确定每根键的画法, 再并行生成实例
+    const BondTable& table = scene->bond_table;
+    map<int, bool> aromatic_map;
+    vector<BondType> key_types(table.size());
+    for(size_t i = 0; i < table.size(); ++i){
+        BondType bond_type = table.order[i] == BOND_DOUBLE ? MiniRDKit::Bond::DOUBLE :
+                             table.order[i] == BOND_AROMATIC ? MiniRDKit::Bond::AROMATIC : MiniRDKit::Bond::SINGLE;
+        key_types[i] = key_Type(bond_type, table.first[i], table.second[i], aromatic_map);
+    }
+    build_BondInstances(atom_instances, table.first, table.second, key_types, bond_instances);
+
+    // 多MODEL的PDB每个模型一帧, 多构象的分子每个构象一帧
+    if(!progress(70, "reading frames"))
+        return;
+    if(from_table && suffix == ".pdb")
+        frame_count = read_PdbFrames(path, atom_instances.size(), frames);
+    if(frame_count > 1)
+        scene->trajectory = make_shared<MemoryTrajectory>(atom_instances.size(), frames);
+
+    if(!progress(80, "building bvh"))
+        return;
+    glm::vec3 sum(0.0f);
+    if(!atom_instances.empty())
+        scene->lower = scene->upper = atom_instances[0].center;
+    for(const AtomInstance& atom: atom_instances){
+        sum += atom.center;
+        scene->lower = glm::min(scene->lower, atom.center);
+        scene->upper = glm::max(scene->upper, atom.center);
+    }
+    if(!atom_instances.empty())
+        scene->center = sum / float(atom_instances.size());
+
+    ThreadPool& pool = ThreadPool::instance();
+    vector<BoundingBox> boxes(atom_instances.size());
+    pool.parallelFor(0, atom_instances.size(), 8192, [&](size_t first, size_t last){
+        for(size_t i = first; i < last; ++i)
+            boxes[i] = atom_Bounds(atom_instances[i]);
+    });
+    scene->atom_bvh.build(boxes);
+
+    boxes.resize(bond_instances.size());
+    pool.parallelFor(0, bond_instances.size(), 8192, [&](size_t first, size_t last){
+        for(size_t i = first; i < last; ++i)
+            boxes[i] = bond_Bounds(bond_instances[i]);
+    });
+    scene->bond_bvh.build(boxes);
+    scene->scene_graph.build(scene->atom_table);
+
+    // 轨迹帧不进缓存, 有多帧的文件每次都重新读取
+    if(!progress(95, "writing cache"))
+        return;
+    if(!scene->trajectory)
+        write_SceneCache(path, *scene);
+    if(!progress(100, "done"))
+        return;
+    emit jobFinished(job, scene, QString());
+}
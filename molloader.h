@@ -0,0 +1,98 @@
+#ifndef MOLLOADER_H
+#define MOLLOADER_H
+
+#include <QObject>
+#include <QString>
+#include <QFuture>
+#include <QList>
+#include <QSharedPointer>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <FileParsers/FileParsers.h>
+#include <GraphMol/ROMol.h>
+
+#include <glm/glm.hpp>
+
+#include "instances.h"
+#include "bvh.h"
+#include "scenegraph.h"
+#include "moltable.h"
+#include "trajectory.h"
+#include "trajectoryfile.h"
+
+using namespace std;
+
+// 后台线程构建好的完整场景, 由MolViewer在paintGL开始时整体交换进来
+struct MolScene{
+    MolScene() {}
+    ~MolScene()                                 { delete mol; }
+
+    QString path;
+    MiniRDKit::RWMol* mol = nullptr;           // 只有走MiniRDKit时才有
+    AtomTable atom_table;
+    BondTable bond_table;
+    vector<AtomInstance> atom_instances;
+    vector<BondInstance> bond_instances;
+    Bvh atom_bvh;
+    Bvh bond_bvh;
+    SceneGraph scene_graph;                     // 由原子表的链/残基建立, 不进缓存
+    shared_ptr<Trajectory> trajectory;          // 多于一帧时才有
+    glm::vec3 lower = glm::vec3(0.0f);          // 原子中心的包围盒
+    glm::vec3 upper = glm::vec3(0.0f);
+    glm::vec3 center = glm::vec3(0.0f);         // 原子中心的平均值
+
+private:
+    MolScene(const MolScene&);
+    MolScene& operator=(const MolScene&);
+};
+
+BoundingBox atom_Bounds(const AtomInstance& atom);
+BoundingBox bond_Bounds(const BondInstance& bond);
+
+// 在QtConcurrent线程中解析分子文件并生成实例/BVH, 通过信号报告进度和结果
+// 新的load()会取消尚未完成的任务, 被取消或过期任务的结果直接丢弃
+class MolLoader: public QObject{
+    Q_OBJECT
+
+    public:
+        explicit MolLoader(QObject *parent = nullptr);
+        ~MolLoader() Q_DECL_OVERRIDE;
+
+        void load(const QString& path);
+        void cancel();
+        bool isLoading() const                  { return cancel_flag != nullptr; }
+
+        // 为当前结构打开DCD/XTC轨迹; 首次打开要扫描建立帧索引, 同样放在后台
+        void loadTrajectory(const QString& path, size_t atom_count);
+
+    signals:
+        void progressChanged(int percent, const QString& stage);
+        void loaded(QSharedPointer<MolScene> scene);
+        void failed(const QString& message);
+        void canceled();
+        void trajectoryLoaded(shared_ptr<Trajectory> trajectory);
+
+        // 仅内部使用: 工作线程发出, 排队到GUI线程后按任务编号过滤
+        void jobProgress(int job, int percent, const QString& stage);
+        void jobFinished(int job, QSharedPointer<MolScene> scene, const QString& error);
+        void trajectoryFinished(int job, shared_ptr<Trajectory> trajectory, const QString& error);
+
+    private slots:
+        void report_Progress(int job, int percent, const QString& stage);
+        void finish_Job(int job, QSharedPointer<MolScene> scene, const QString& error);
+        void finish_Trajectory(int job, shared_ptr<Trajectory> trajectory, const QString& error);
+
+    private:
+        void run_Job(const QString& path, int job, const atomic<bool>& cancelled);
+
+        int generation = 0;                     // 当前任务编号, 只在GUI线程中读写
+        int trajectory_generation = 0;          // 新的结构或轨迹会让未完成的轨迹任务过期
+        shared_ptr<atomic<bool>> cancel_flag;
+        QList<QFuture<void>> jobs;
+};
+
+Q_DECLARE_METATYPE(std::shared_ptr<Trajectory>)
+
+#endif // MOLLOADER_H
@@ -0,0 +1,691 @@
+#include "moltable.h"
+
+#include <QFile>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include "threadpool.h"
+
+void AtomTable::resize(size_t n){
+    x.resize(n);
+    y.resize(n);
+    z.resize(n);
+    atomic_number.resize(n);
+    serial.resize(n);
+    residue_seq.resize(n);
+    residue_name.resize(n);
+    chain.resize(n);
+}
+
+void BondTable::resize(size_t n){
+    first.resize(n);
+    second.resize(n);
+    order.resize(n);
+}
+
+static const char* ELEMENT_SYMBOLS[] = {
+    "",   "H",  "He", "Li", "Be", "B",  "C",  "N",  "O",  "F",  "Ne",
+    "Na", "Mg", "Al", "Si", "P",  "S",  "Cl", "Ar", "K",  "Ca",
+    "Sc", "Ti", "V",  "Cr", "Mn", "Fe", "Co", "Ni", "Cu", "Zn",
+    "Ga", "Ge", "As", "Se", "Br", "Kr", "Rb", "Sr", "Y",  "Zr",
+    "Nb", "Mo", "Tc", "Ru", "Rh", "Pd", "Ag", "Cd", "In", "Sn",
+    "Sb", "Te", "I",  "Xe", "Cs", "Ba", "La", "Ce", "Pr", "Nd",
+    "Pm", "Sm", "Eu", "Gd", "Tb", "Dy", "Ho", "Er", "Tm", "Yb",
+    "Lu", "Hf", "Ta", "W",  "Re", "Os", "Ir", "Pt", "Au", "Hg",
+    "Tl", "Pb", "Bi", "Po", "At", "Rn", "Fr", "Ra", "Ac", "Th",
+    "Pa", "U"
+};
+
+static char to_Upper(char c)    { return (c >= 'a' && c <= 'z') ? c-'a'+'A' : c; }
+static bool is_Digit(char c)    { return c >= '0' && c <= '9'; }
+static bool is_Space(char c)    { return c == ' ' || c == '\t' || c == '\r'; }
+
+int element_Number(const char* symbol, int length){
+    while(length > 0 && is_Space(*symbol)){
+        ++symbol;
+        --length;
+    }
+    while(length > 0 && is_Space(symbol[length-1]))
+        --length;
+    if(length < 1 || length > 2)
+        return 0;
+    for(int n = 1; n < int(sizeof(ELEMENT_SYMBOLS)/sizeof(ELEMENT_SYMBOLS[0])); ++n){
+        const char* s = ELEMENT_SYMBOLS[n];
+        if(int(strlen(s)) == length && to_Upper(s[0]) == to_Upper(symbol[0]) && (length == 1 || to_Upper(s[1]) == to_Upper(symbol[1])))
+            return n;
+    }
+    return 0;
+}
+
+const char* element_Symbol(int atomic_number){
+    if(atomic_number < 0 || atomic_number >= int(sizeof(ELEMENT_SYMBOLS)/sizeof(ELEMENT_SYMBOLS[0])))
+        return ELEMENT_SYMBOLS[0];
+    return ELEMENT_SYMBOLS[atomic_number];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// number parsing on [p, end) without copying or locale lookups
+///////////////////////////////////////////////////////////////////////////////
+static bool parse_Int(const char* p, const char* end, int& value){
+    while(p < end && is_Space(*p)) ++p;
+    bool negative = false;
+    if(p < end && (*p == '-' || *p == '+')){
+        negative = *p == '-';
+        ++p;
+    }
+    if(p >= end || !is_Digit(*p))
+        return false;
+    int v = 0;
+    for(; p < end && is_Digit(*p); ++p)
+        v = v*10 + (*p-'0');
+    value = negative ? -v : v;
+    return true;
+}
+
+static float parse_Float(const char* p, const char* end){
+    while(p < end && is_Space(*p)) ++p;
+    bool negative = false;
+    if(p < end && (*p == '-' || *p == '+')){
+        negative = *p == '-';
+        ++p;
+    }
+    double value = 0.0;
+    for(; p < end && is_Digit(*p); ++p)
+        value = value*10.0 + (*p-'0');
+    if(p < end && *p == '.'){
+        double scale = 0.1;
+        for(++p; p < end && is_Digit(*p); ++p){
+            value += (*p-'0')*scale;
+            scale *= 0.1;
+        }
+    }
+    if(p < end && (*p == 'e' || *p == 'E')){
+        int exponent = 0;
+        if(parse_Int(p+1, end, exponent))
+            value *= pow(10.0, exponent);
+    }
+    return float(negative ? -value : value);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// line chunks: [begin, end) always starts at a line start and ends after '\n'
+///////////////////////////////////////////////////////////////////////////////
+struct LineChunk{
+    const char* begin;
+    const char* end;
+};
+
+static const char* next_Line(const char* p, const char* end){
+    const char* newline = (const char*)memchr(p, '\n', end-p);
+    return newline ? newline+1 : end;
+}
+
+static const char* line_End(const char* line, const char* end){
+    const char* newline = (const char*)memchr(line, '\n', end-line);
+    const char* e = newline ? newline : end;
+    if(e > line && e[-1] == '\r')
+        --e;
+    return e;
+}
+
+static vector<LineChunk> split_Chunks(const char* begin, const char* end){
+    size_t bytes = end-begin;
+    size_t target = max<size_t>(1 << 20, bytes/(4*ThreadPool::instance().getThreadCount()+1));
+    vector<LineChunk> chunks;
+    const char* p = begin;
+    while(p < end){
+        const char* q = p + min(target, size_t(end-p));
+        if(q < end)
+            q = next_Line(q, end);
+        chunks.push_back({p, q});
+        p = q;
+    }
+    return chunks;
+}
+
+static bool starts_With(const char* line, const char* line_end, const char* prefix){
+    size_t n = strlen(prefix);
+    return size_t(line_end-line) >= n && memcmp(line, prefix, n) == 0;
+}
+
+// 两遍并行: count_Records数出每块中匹配的行数, 返回前缀和即各块的输出位置(末项为总数),
+// 调用者按总数分配后由fill_Records并行填写
+template<class Match>
+static vector<size_t> count_Records(const vector<LineChunk>& chunks, Match match){
+    vector<size_t> offsets(chunks.size()+1, 0);
+    ThreadPool::instance().parallelFor(0, chunks.size(), 1, [&](size_t first, size_t last){
+        for(size_t c = first; c < last; ++c){
+            size_t n = 0;
+            for(const char* line = chunks[c].begin; line < chunks[c].end; line = next_Line(line, chunks[c].end)){
+                if(match(line, line_End(line, chunks[c].end)))
+                    ++n;
+            }
+            offsets[c+1] = n;
+        }
+    });
+    for(size_t c = 0; c < chunks.size(); ++c)
+        offsets[c+1] += offsets[c];
+    return offsets;
+}
+
+template<class Match, class Parse>
+static void fill_Records(const vector<LineChunk>& chunks, const vector<size_t>& offsets, Match match, Parse parse){
+    if(offsets.back() == 0)
+        return;
+    ThreadPool::instance().parallelFor(0, chunks.size(), 1, [&](size_t first, size_t last){
+        for(size_t c = first; c < last; ++c){
+            size_t index = offsets[c];
+            for(const char* line = chunks[c].begin; line < chunks[c].end; line = next_Line(line, chunks[c].end)){
+                const char* e = line_End(line, chunks[c].end);
+                if(match(line, e))
+                    parse(line, e, index++);
+            }
+        }
+    });
+}
+
+// 原子编号到下标; 编号大多连续, 优先用数组
+class SerialIndex{
+public:
+    explicit SerialIndex(const vector<int>& serials){
+        int max_serial = 0;
+        for(int s: serials)
+            max_serial = max(max_serial, s);
+        if(size_t(max_serial) < 4*serials.size()+1024){
+            dense.assign(max_serial+1, -1);
+            for(size_t i = 0; i < serials.size(); ++i)
+                if(serials[i] >= 0 && dense[serials[i]] < 0)
+                    dense[serials[i]] = int(i);
+        }else{
+            sparse.reserve(serials.size());
+            for(size_t i = 0; i < serials.size(); ++i)
+                sparse.insert({serials[i], int(i)});
+        }
+    }
+
+    int find(int serial) const{
+        if(!dense.empty())
+            return (serial >= 0 && size_t(serial) < dense.size()) ? dense[serial] : -1;
+        unordered_map<int, int>::const_iterator it = sparse.find(serial);
+        return it == sparse.end() ? -1 : it->second;
+    }
+
+private:
+    vector<int> dense;
+    unordered_map<int, int> sparse;
+};
+
+// 去掉重复(包括反向重复)的键, 保留第一次出现的级数
+static void unique_Bonds(BondTable& bonds){
+    vector<size_t> order(bonds.size());
+    for(size_t i = 0; i < order.size(); ++i){
+        if(bonds.first[i] > bonds.second[i])
+            swap(bonds.first[i], bonds.second[i]);
+        order[i] = i;
+    }
+    stable_sort(order.begin(), order.end(), [&bonds](size_t a, size_t b){
+        return bonds.first[a] != bonds.first[b] ? bonds.first[a] < bonds.first[b] : bonds.second[a] < bonds.second[b];
+    });
+    BondTable result;
+    for(size_t k = 0; k < order.size(); ++k){
+        size_t i = order[k];
+        if(bonds.first[i] == bonds.second[i])
+            continue;
+        if(result.size() > 0 && result.first.back() == bonds.first[i] && result.second.back() == bonds.second[i])
+            continue;
+        result.first.push_back(bonds.first[i]);
+        result.second.push_back(bonds.second[i]);
+        result.order.push_back(bonds.order[i]);
+    }
+    swap(bonds, result);
+}
+
+static const char* map_File(QFile& file, const QString& path, qint64& size, QString* error){
+    file.setFileName(path);
+    if(!file.open(QIODevice::ReadOnly)){
+        if(error) *error = QString("cannot open %1").arg(path);
+        return nullptr;
+    }
+    size = file.size();
+    const char* data = size > 0 ? (const char*)file.map(0, size) : nullptr;
+    if(data == nullptr && error)
+        *error = QString("cannot map %1").arg(path);
+    return data;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// PDB, fixed columns
+///////////////////////////////////////////////////////////////////////////////
+// 原子名从13列开始时只接受这些两字母元素(生物分子中常见的离子/卤素/金属), 其余取13列的单字母
+static const char* PDB_TWO_LETTER_ELEMENTS[] = {
+    "NA", "MG", "AL", "CL", "CA", "MN", "FE", "CO", "NI", "CU", "ZN", "SE", "BR", "SR", "CD", "BA", "PT", "AU", "HG", "PB"
+};
+
+// 调用者保证length > 13, 即13-14列可读
+static int pdb_NameElement(const char* line, size_t length){
+    const char* name = line+12;
+    int name_length = 0;
+    for(size_t c = 12; c < 16 && c < length; ++c){
+        if(line[c] != ' ')
+            ++name_length;
+    }
+    if(name[0] == ' ' || is_Digit(name[0]))
+        return element_Number(name+1, 1);
+    // 13列为H的4字符名(HG21, HE21, HD11, HH11)是氢, 不是汞或氦
+    if(to_Upper(name[0]) == 'H' && name_length == 4)
+        return 1;
+    for(const char* symbol: PDB_TWO_LETTER_ELEMENTS){
+        if(to_Upper(name[0]) == symbol[0] && to_Upper(name[1]) == symbol[1])
+            return element_Number(symbol, 2);
+    }
+    return element_Number(name, 1);
+}
+
+static bool is_AtomRecord(const char* line, const char* end){
+    return starts_With(line, end, "ATOM  ") || starts_With(line, end, "HETATM");
+}
+
+static void parse_PdbAtom(const char* line, const char* end, size_t i, AtomTable& atoms){
+    size_t length = end-line;
+    auto field_end = [line, length](size_t last){ return line + min(last, length); };
+
+    int serial = -1;
+    parse_Int(line+6, field_end(11), serial);
+    atoms.serial[i] = serial;
+
+    array<char, 4> residue = {{0, 0, 0, 0}};
+    int n = 0;
+    for(size_t c = 17; c < 20 && c < length; ++c){
+        if(line[c] != ' ')
+            residue[n++] = line[c];
+    }
+    atoms.residue_name[i] = residue;
+    atoms.chain[i] = length > 21 ? line[21] : ' ';
+    int seq = 0;
+    if(length > 22)
+        parse_Int(line+22, field_end(26), seq);
+    atoms.residue_seq[i] = seq;
+
+    atoms.x[i] = length > 30 ? parse_Float(line+30, field_end(38)) : 0.0f;
+    atoms.y[i] = length > 38 ? parse_Float(line+38, field_end(46)) : 0.0f;
+    atoms.z[i] = length > 46 ? parse_Float(line+46, field_end(54)) : 0.0f;
+
+    // 优先用77-78列的元素符号, 否则从原子名(13-16列)推断: 13列为空格或数字时是单字母元素
+    int number = length > 76 ? element_Number(line+76, int(min<size_t>(length, 78)-76)) : 0;
+    if(number == 0 && length > 13)
+        number = pdb_NameElement(line, length);
+    atoms.atomic_number[i] = (unsigned char)number;
+}
+
+bool read_PdbTable(const QString& path, AtomTable& atoms, BondTable& bonds, QString* error){
+    QFile file;
+    qint64 size = 0;
+    const char* data = map_File(file, path, size, error);
+    if(data == nullptr)
+        return false;
+    const char* end = data + size;
+
+    // 多MODEL文件只取第一个模型, 其余的帧由轨迹播放读取
+    static const char ENDMDL[] = "\nENDMDL";
+    const char* model_end = search(data, end, ENDMDL, ENDMDL+sizeof(ENDMDL)-1);
+    if(model_end != end)
+        model_end = next_Line(model_end+1, end);
+
+    vector<LineChunk> chunks = split_Chunks(data, model_end);
+    vector<size_t> offsets = count_Records(chunks, is_AtomRecord);
+    size_t count = offsets.back();
+    atoms.resize(count);
+    fill_Records(chunks, offsets, is_AtomRecord, [&atoms](const char* line, const char* e, size_t i){ parse_PdbAtom(line, e, i, atoms); });
+    if(count == 0){
+        if(error) *error = QString("no ATOM/HETATM records in %1").arg(path);
+        return false;
+    }
+
+    // CONECT记录在模型之后, 在整个文件中查找; 每行最多4个成键原子
+    SerialIndex index(atoms.serial);
+    vector<LineChunk> all_chunks = split_Chunks(data, end);
+    vector<BondTable> partial(all_chunks.size());
+    ThreadPool::instance().parallelFor(0, all_chunks.size(), 1, [&](size_t first, size_t last){
+        for(size_t c = first; c < last; ++c){
+            BondTable& local = partial[c];
+            for(const char* line = all_chunks[c].begin; line < all_chunks[c].end; line = next_Line(line, all_chunks[c].end)){
+                const char* e = line_End(line, all_chunks[c].end);
+                if(!starts_With(line, e, "CONECT"))
+                    continue;
+                size_t length = e-line;
+                int serial;
+                if(length < 11 || !parse_Int(line+6, line+11, serial))
+                    continue;
+                int from = index.find(serial);
+                for(size_t column = 11; from >= 0 && column+5 <= length; column += 5){
+                    int bonded;
+                    if(!parse_Int(line+column, line+column+5, bonded))
+                        continue;
+                    int to = index.find(bonded);
+                    if(to < 0)
+                        continue;
+                    local.first.push_back(from);
+                    local.second.push_back(to);
+                    local.order.push_back(BOND_SINGLE);
+                }
+            }
+        }
+    });
+    bonds.clear();
+    for(const BondTable& local: partial){
+        bonds.first.insert(bonds.first.end(), local.first.begin(), local.first.end());
+        bonds.second.insert(bonds.second.end(), local.second.begin(), local.second.end());
+        bonds.order.insert(bonds.order.end(), local.order.begin(), local.order.end());
+    }
+    unique_Bonds(bonds);
+    return true;
+}
+
+size_t read_PdbFrames(const QString& path, size_t atom_count, vector<float>& xyz, QString* error){
+    xyz.clear();
+    QFile file;
+    qint64 size = 0;
+    const char* data = map_File(file, path, size, error);
+    if(data == nullptr || atom_count == 0)
+        return 0;
+    const char* end = data + size;
+
+    // 以ENDMDL为界切出各个模型, 最后一个ENDMDL之后的内容(CONECT等)不算一帧
+    static const char ENDMDL[] = "\nENDMDL";
+    vector<LineChunk> models;
+    const char* begin = data;
+    while(begin < end){
+        const char* model_end = search(begin, end, ENDMDL, ENDMDL+sizeof(ENDMDL)-1);
+        if(model_end == end)
+            break;
+        model_end = next_Line(model_end+1, end);
+        models.push_back({begin, model_end});
+        begin = model_end;
+    }
+    if(models.size() < 2)
+        return models.size();
+
+    xyz.resize(models.size()*3*atom_count);
+    vector<char> complete(models.size(), 0);
+    ThreadPool::instance().parallelFor(0, models.size(), 1, [&](size_t first, size_t last){
+        for(size_t m = first; m < last; ++m){
+            float* frame = &xyz[m*3*atom_count];
+            size_t i = 0;
+            for(const char* line = models[m].begin; line < models[m].end; line = next_Line(line, models[m].end)){
+                const char* e = line_End(line, models[m].end);
+                if(!is_AtomRecord(line, e))
+                    continue;
+                if(i == atom_count){
+                    ++i;
+                    break;
+                }
+                size_t length = e-line;
+                frame[3*i]   = length > 30 ? parse_Float(line+30, line+min<size_t>(38, length)) : 0.0f;
+                frame[3*i+1] = length > 38 ? parse_Float(line+38, line+min<size_t>(46, length)) : 0.0f;
+                frame[3*i+2] = length > 46 ? parse_Float(line+46, line+min<size_t>(54, length)) : 0.0f;
+                ++i;
+            }
+            complete[m] = i == atom_count;
+        }
+    });
+
+    size_t frames = 0;
+    while(frames < models.size() && complete[frames])
+        ++frames;
+    if(frames < models.size() && error)
+        *error = QString("model %1 of %2 does not match the first model").arg(frames+1).arg(path);
+    xyz.resize(frames*3*atom_count);
+    return frames;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// bond perception on a uniform grid
+///////////////////////////////////////////////////////////////////////////////
+// 共价半径(埃, Cordero 2008), 按原子序数; 未知元素按碳处理
+static const float COVALENT_RADII[] = {
+    0.76f, 0.31f, 0.28f, 1.28f, 0.96f, 0.84f, 0.76f, 0.71f, 0.66f, 0.57f, 0.58f,
+    1.66f, 1.41f, 1.21f, 1.11f, 1.07f, 1.05f, 1.02f, 1.06f, 2.03f, 1.76f,
+    1.70f, 1.60f, 1.53f, 1.39f, 1.39f, 1.32f, 1.26f, 1.24f, 1.32f, 1.22f,
+    1.22f, 1.20f, 1.19f, 1.20f, 1.20f, 1.16f, 2.20f, 1.95f, 1.90f, 1.75f,
+    1.64f, 1.54f, 1.47f, 1.46f, 1.42f, 1.39f, 1.45f, 1.44f, 1.42f, 1.39f,
+    1.39f, 1.38f, 1.39f, 1.40f, 2.44f, 2.15f, 2.07f, 2.04f, 2.03f, 2.01f,
+    1.99f, 1.98f, 1.98f, 1.96f, 1.94f, 1.92f, 1.92f, 1.89f, 1.90f, 1.87f,
+    1.87f, 1.75f, 1.70f, 1.62f, 1.51f, 1.44f, 1.41f, 1.36f, 1.36f, 1.32f,
+    1.45f, 1.46f, 1.48f, 1.40f, 1.50f, 1.50f, 2.60f, 2.21f, 2.15f, 2.06f,
+    2.00f, 1.96f
+};
+static const float BOND_TOLERANCE = 0.45f;
+static const float MIN_BOND_LENGTH = 0.4f;     // 更近的是替代构象之类的重叠原子
+
+static float covalent_Radius(unsigned char atomic_number){
+    return atomic_number < sizeof(COVALENT_RADII)/sizeof(COVALENT_RADII[0]) ? COVALENT_RADII[atomic_number] : COVALENT_RADII[0];
+}
+
+void perceive_Bonds(const AtomTable& atoms, BondTable& bonds){
+    size_t n = atoms.size();
+    if(n < 2)
+        return;
+    vector<float> radius(n);
+    float max_radius = 0.0f;
+    float lower[3] = {atoms.x[0], atoms.y[0], atoms.z[0]};
+    float upper[3] = {atoms.x[0], atoms.y[0], atoms.z[0]};
+    for(size_t i = 0; i < n; ++i){
+        radius[i] = covalent_Radius(atoms.atomic_number[i]);
+        max_radius = max(max_radius, radius[i]);
+        const float p[3] = {atoms.x[i], atoms.y[i], atoms.z[i]};
+        for(int d = 0; d < 3; ++d){
+            lower[d] = min(lower[d], p[d]);
+            upper[d] = max(upper[d], p[d]);
+        }
+    }
+
+    // 格子边长不小于最大成键距离, 成键的两个原子必在相邻格子中; 稀疏的盒子放大格子, 格子数不超过原子数的两倍
+    float cell = 2.0f*max_radius + BOND_TOLERANCE;
+    size_t dims[3];
+    while(true){
+        double total = 1.0;
+        for(int d = 0; d < 3; ++d){
+            dims[d] = size_t((upper[d]-lower[d])/cell) + 1;
+            total *= double(dims[d]);
+        }
+        if(total <= 2.0*n + 64)
+            break;
+        cell *= float(cbrt(total/(2.0*n + 64))) * 1.01f;
+    }
+    size_t cell_count = dims[0]*dims[1]*dims[2];
+    auto cell_Coord = [&](float value, int d){
+        return min(size_t((value-lower[d])/cell), dims[d]-1);
+    };
+
+    // 计数排序: cell_start[c]..cell_start[c+1]是格子c中的原子
+    vector<unsigned int> cell_of(n);
+    vector<unsigned int> cell_start(cell_count+1, 0);
+    for(size_t i = 0; i < n; ++i){
+        size_t c = (cell_Coord(atoms.z[i], 2)*dims[1] + cell_Coord(atoms.y[i], 1))*dims[0] + cell_Coord(atoms.x[i], 0);
+        cell_of[i] = (unsigned int)c;
+        ++cell_start[c+1];
+    }
+    for(size_t c = 0; c < cell_count; ++c)
+        cell_start[c+1] += cell_start[c];
+    vector<unsigned int> sorted(n);
+    vector<unsigned int> fill(cell_start.begin(), cell_start.end()-1);
+    for(size_t i = 0; i < n; ++i)
+        sorted[fill[cell_of[i]]++] = (unsigned int)i;
+
+    // 格子分块并行, 每块写自己的键表, 最后按块顺序拼接, 结果与线程数无关
+    ThreadPool& pool = ThreadPool::instance();
+    size_t block_count = min(cell_count, size_t(8)*pool.getThreadCount());
+    size_t block_size = (cell_count + block_count-1) / block_count;
+    vector<BondTable> partial(block_count);
+    pool.parallelFor(0, block_count, 1, [&](size_t first_block, size_t last_block){
+        for(size_t b = first_block; b < last_block; ++b){
+            BondTable& local = partial[b];
+            size_t cell_end = min(cell_count, (b+1)*block_size);
+            for(size_t c = b*block_size; c < cell_end; ++c){
+                size_t cx = c % dims[0];
+                size_t cy = (c / dims[0]) % dims[1];
+                size_t cz = c / (dims[0]*dims[1]);
+                for(unsigned int k = cell_start[c]; k < cell_start[c+1]; ++k){
+                    unsigned int i = sorted[k];
+                    for(size_t z = (cz > 0 ? cz-1 : 0); z <= min(cz+1, dims[2]-1); ++z)
+                    for(size_t y = (cy > 0 ? cy-1 : 0); y <= min(cy+1, dims[1]-1); ++y)
+                    for(size_t x = (cx > 0 ? cx-1 : 0); x <= min(cx+1, dims[0]-1); ++x){
+                        size_t neighbor = (z*dims[1] + y)*dims[0] + x;
+                        for(unsigned int m = cell_start[neighbor]; m < cell_start[neighbor+1]; ++m){
+                            unsigned int j = sorted[m];
+                            if(j <= i)
+                                continue;           // 每对只在下标较小的原子处记录一次
+                            float dx = atoms.x[i]-atoms.x[j];
+                            float dy = atoms.y[i]-atoms.y[j];
+                            float dz = atoms.z[i]-atoms.z[j];
+                            float d2 = dx*dx + dy*dy + dz*dz;
+                            float limit = radius[i] + radius[j] + BOND_TOLERANCE;
+                            if(d2 < limit*limit && d2 > MIN_BOND_LENGTH*MIN_BOND_LENGTH){
+                                local.first.push_back(i);
+                                local.second.push_back(j);
+                                local.order.push_back(BOND_SINGLE);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+    for(const BondTable& local: partial){
+        bonds.first.insert(bonds.first.end(), local.first.begin(), local.first.end());
+        bonds.second.insert(bonds.second.end(), local.second.begin(), local.second.end());
+        bonds.order.insert(bonds.order.end(), local.order.begin(), local.order.end());
+    }
+    unique_Bonds(bonds);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// mol2, whitespace separated fields
+///////////////////////////////////////////////////////////////////////////////
+static int split_Fields(const char* line, const char* end, const char** begins, const char** ends, int max_fields){
+    int n = 0;
+    const char* p = line;
+    while(p < end && n < max_fields){
+        while(p < end && is_Space(*p)) ++p;
+        if(p >= end)
+            break;
+        begins[n] = p;
+        while(p < end && !is_Space(*p)) ++p;
+        ends[n++] = p;
+    }
+    return n;
+}
+
+static bool is_DataLine(const char* line, const char* end){
+    const char* p = line;
+    while(p < end && is_Space(*p)) ++p;
+    return p < end && *p != '#';
+}
+
+// @<TRIPOS>name段的内容区间, 不存在时返回false
+static bool find_Section(const char* data, const char* end, const char* name, const char*& first, const char*& last){
+    string tag = string("@<TRIPOS>") + name;
+    const char* p = search(data, end, tag.begin(), tag.end());
+    if(p == end)
+        return false;
+    first = next_Line(p, end);
+    static const char NEXT[] = "\n@<TRIPOS>";
+    last = search(first, end, NEXT, NEXT+sizeof(NEXT)-1);
+    if(last != end)
+        ++last;
+    return true;
+}
+
+bool read_Mol2Table(const QString& path, AtomTable& atoms, BondTable& bonds, QString* error){
+    QFile file;
+    qint64 size = 0;
+    const char* data = map_File(file, path, size, error);
+    if(data == nullptr)
+        return false;
+    const char* end = data + size;
+
+    const char* atom_first;
+    const char* atom_last;
+    if(!find_Section(data, end, "ATOM", atom_first, atom_last)){
+        if(error) *error = QString("no @<TRIPOS>ATOM section in %1").arg(path);
+        return false;
+    }
+
+    // id name x y z type [subst_id [subst_name [charge]]]
+    vector<LineChunk> chunks = split_Chunks(atom_first, atom_last);
+    vector<size_t> offsets = count_Records(chunks, is_DataLine);
+    size_t count = offsets.back();
+    atoms.resize(count);
+    fill_Records(chunks, offsets, is_DataLine, [&atoms](const char* line, const char* e, size_t i){
+        const char* b[8];
+        const char* f[8];
+        int n = split_Fields(line, e, b, f, 8);
+        int serial = -1;
+        if(n > 0)
+            parse_Int(b[0], f[0], serial);
+        atoms.serial[i] = serial;
+        atoms.x[i] = n > 2 ? parse_Float(b[2], f[2]) : 0.0f;
+        atoms.y[i] = n > 3 ? parse_Float(b[3], f[3]) : 0.0f;
+        atoms.z[i] = n > 4 ? parse_Float(b[4], f[4]) : 0.0f;
+
+        // 原子类型如C.ar, N.3, Cl: '.'之前是元素符号
+        int number = 0;
+        if(n > 5){
+            const char* dot = (const char*)memchr(b[5], '.', f[5]-b[5]);
+            number = element_Number(b[5], int((dot ? dot : f[5]) - b[5]));
+        }
+        atoms.atomic_number[i] = (unsigned char)number;
+
+        int seq = 0;
+        if(n > 6)
+            parse_Int(b[6], f[6], seq);
+        atoms.residue_seq[i] = seq;
+        array<char, 4> residue = {{0, 0, 0, 0}};
+        for(int c = 0; n > 7 && c < 3 && b[7]+c < f[7] && !is_Digit(b[7][c]); ++c)
+            residue[c] = b[7][c];
+        atoms.residue_name[i] = residue;
+        atoms.chain[i] = ' ';
+    });
+    if(count == 0){
+        if(error) *error = QString("empty @<TRIPOS>ATOM section in %1").arg(path);
+        return false;
+    }
+
+    // id origin target type; type为1/2/3/ar/am/du/un/nc
+    bonds.clear();
+    const char* bond_first;
+    const char* bond_last;
+    if(find_Section(data, end, "BOND", bond_first, bond_last)){
+        SerialIndex index(atoms.serial);
+        chunks = split_Chunks(bond_first, bond_last);
+        offsets = count_Records(chunks, is_DataLine);
+        bonds.resize(offsets.back());
+        fill_Records(chunks, offsets, is_DataLine, [&](const char* line, const char* e, size_t i){
+            const char* b[4];
+            const char* f[4];
+            int n = split_Fields(line, e, b, f, 4);
+            int from = -1, to = -1;
+            if(n > 2 && parse_Int(b[1], f[1], from) && parse_Int(b[2], f[2], to)){
+                from = index.find(from);
+                to = index.find(to);
+            }
+            // 无效的键首尾相同, 由unique_Bonds去掉
+            bonds.first[i] = from >= 0 && to >= 0 ? from : 0;
+            bonds.second[i] = from >= 0 && to >= 0 ? to : 0;
+
+            unsigned char order = BOND_SINGLE;
+            if(n > 3){
+                if(f[3]-b[3] == 2 && b[3][0] == 'a' && b[3][1] == 'r')
+                    order = BOND_AROMATIC;
+                else if(f[3]-b[3] == 1 && b[3][0] >= '1' && b[3][0] <= '3')
+                    order = b[3][0]-'0';
+            }
+            bonds.order[i] = order;
+        });
+        unique_Bonds(bonds);
+    }
+    return true;
+}
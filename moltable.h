@@ -0,0 +1,61 @@
+#ifndef MOLTABLE_H
+#define MOLTABLE_H
+
+#include <array>
+#include <vector>
+#include <QString>
+
+using namespace std;
+
+// 显示所需的原子数据, 按列(structure of arrays)存放
+struct AtomTable{
+    vector<float> x, y, z;
+    vector<unsigned char> atomic_number;
+    vector<int> serial;                         // 文件中的原子编号, CONECT/BOND记录按它引用原子
+    vector<int> residue_seq;
+    vector<array<char, 4>> residue_name;        // 以'\0'结尾
+    vector<char> chain;
+
+    size_t size() const                         { return x.size(); }
+    void resize(size_t n);
+    void clear()                                { resize(0); }
+};
+
+// 键的级数
+enum BondOrder{
+    BOND_SINGLE = 1,
+    BOND_DOUBLE = 2,
+    BOND_TRIPLE = 3,
+    BOND_AROMATIC = 4,
+};
+
+// 键表, first/second是AtomTable中的下标
+struct BondTable{
+    vector<unsigned int> first, second;
+    vector<unsigned char> order;
+
+    size_t size() const                         { return first.size(); }
+    void resize(size_t n);
+    void clear()                                { resize(0); }
+};
+
+// 元素符号(不区分大小写)对应的原子序数, 未知时返回0
+int element_Number(const char* symbol, int length);
+// 原子序数对应的元素符号, 未知时返回""
+const char* element_Symbol(int atomic_number);
+
+// 只为显示服务的快速读取: 内存映射整个文件, 按行块并行解析
+// PDB: ATOM/HETATM/CONECT, 只取第一个MODEL; mol2: @<TRIPOS>ATOM/BOND
+// 失败时返回false并在error中给出原因, 调用者可退回MiniRDKit
+bool read_PdbTable(const QString& path, AtomTable& atoms, BondTable& bonds, QString* error = nullptr);
+bool read_Mol2Table(const QString& path, AtomTable& atoms, BondTable& bonds, QString* error = nullptr);
+
+// 由坐标推断共价键: 原子按最大成键距离分格, 只比较相邻格子, 各格子并行
+// 距离小于两原子共价半径之和+0.45埃(且大于0.4埃)的原子对作为单键追加到bonds, 再与已有的键去重
+void perceive_Bonds(const AtomTable& atoms, BondTable& bonds);
+
+// 多MODEL的PDB: 每个模型一帧, 按帧依次把atom_count个原子的x,y,z追加到xyz, 各模型并行解析
+// 原子数与atom_count不符的模型及其后的模型都被舍弃; 返回读到的帧数, 单模型文件返回1或0
+size_t read_PdbFrames(const QString& path, size_t atom_count, vector<float>& xyz, QString* error = nullptr);
+
+#endif // MOLTABLE_H
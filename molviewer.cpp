@@ -1,20 +1,27 @@
 ﻿#include "molviewer.h"
 
 #include <QDebug>
+#include <QFile>
 #include <QTimer>
 #include <QKeyEvent>
+#include <QMessageBox>
 #include <QDateTime>
 
+#include "threadpool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
 //glm convert to QMatrix:https://stackoverflow.com/questions/36249982/opengl-and-qt-5-5-glmperspective-doesnt-work
 
 // lighting
 static QVector3D lightPos(5.0f, 5.0f, 5.0f);
 
-QVector3D system_center(0.0f, 0.0f, -1.0f);
-
-vector<Sphere* > balls_copy;
+// ID缓冲中键的编号带最高位, 与原子区分; 0是背景(见pickid.fs)
+static const unsigned int PICK_BOND_BIT = 0x80000000u;
 
-int total_indexcount = 0;
+QVector3D system_center(0.0f, 0.0f, -1.0f);
 
 MolViewer::MolViewer(QWidget *parent, string molfile) :
     QOpenGLWidget(parent), MolFilePath(molfile){
@@ -26,258 +33,500 @@ MolViewer::MolViewer(QWidget *parent, string molfile) :
 
     // 必须先设置聚焦策略，否则无法响应键盘事件
     setFocusPolicy(Qt::ClickFocus);
+    // 未按键时的移动也要收到, 用于悬停拾取
+    setMouseTracking(true);
+
+    // 载入在后台进行, 完成后的场景在下一次paintGL开始时换入
+    loader = new MolLoader(this);
+    connect(loader, &MolLoader::loaded, this, &MolViewer::receive_Scene);
+    connect(loader, &MolLoader::trajectoryLoaded, this, &MolViewer::setTrajectory);
+
+    // 60帧/秒推进轨迹, 实际刷新仍由update()合并
+    play_timer = new QTimer(this);
+    play_timer->setTimerType(Qt::PreciseTimer);
+    play_timer->setInterval(16);
+    connect(play_timer, &QTimer::timeout, this, &MolViewer::next_Frame);
+
+    // 拾取的读回在后台完成; 只在有请求在途时按帧间隔查看栅栏, 期间若有重画则在paintGL中顺带取回
+    pick_timer = new QTimer(this);
+    pick_timer->setInterval(16);
+    connect(pick_timer, &QTimer::timeout, this, &MolViewer::finish_Pick);
+    rubber_band = new QRubberBand(QRubberBand::Rectangle, this);
+    setMolFilePath(molfile);
 }
 
 void MolViewer::setMolFilePath(string mol_file_path){
     MolFilePath = mol_file_path;
+    if(!MolFilePath.empty())
+        loader->load(QString::fromStdString(MolFilePath));
+}
 
+void MolViewer::receive_Scene(QSharedPointer<MolScene> scene){
+    // 旧场景继续显示, 直到下一帧整体交换
+    pending_scene = scene;
+    update();
 }
 
-QVector4D MolViewer::ScreenCoordinate2_WorldCoordinate(int xpos, int ypos){
-    // 3d 正则化（normalised）坐标
-    float x = (2.0*xpos)/this->width() - 1.0f;
-    float y = 1.0f - (2.0f*ypos)/this->height();
-    float z = 1.0f;
+void MolViewer::apply_Scene(){
+    // 与pending_scene交换全部场景数据, 旧数据(包括mol)随pending_scene一起释放
+    MolScene& scene = *pending_scene;
+    swap(mol, scene.mol);
+    swap(atom_table, scene.atom_table);
+    swap(bond_table, scene.bond_table);
+    atom_instances.swap(scene.atom_instances);
+    bond_instances.swap(scene.bond_instances);
+    swap(atom_bvh, scene.atom_bvh);
+    swap(bond_bvh, scene.bond_bvh);
+    swap(scene_graph, scene.scene_graph);
+    swap(trajectory, scene.trajectory);
+    recentFile = scene.path.toStdString();
+
+    create_CoordinateSystem(scene.lower, scene.upper);
+    selection.resize(atom_instances.size());
+    firstMouse = true;
+    all_selected = false;
+    hovered_atom = hovered_bond = -1;
+    drag_node = -1;
+    emit hoverChanged(QString());
+    cancel_Pick();
 
-    // 4d homogeneous clip coordinate
-    QVector4D ray_clip = QVector4D(x, y, -1.0, 1.0);
-//    printMatrx(global_projection);
-    // 4d eye coordinate
-    QVector4D ray_eye = global_projection.inverted()*ray_clip;
-    ray_eye = QVector4D(ray_eye.x(), ray_eye.y(), -1.0, 0.0);
-//    cout<< "ray_eye:" << ray_eye.x() << "," << ray_eye.y() << endl;
+    system_center = QVector3D(scene.center.x, scene.center.y, scene.center.z);
+    camera->front = QVector3D(system_center.x()-camera->position.x(), system_center.y()-camera->position.y(), system_center.z()-camera->position.z());
 
-    // 4d world coordinates
-    QMatrix4x4 view = camera->getViewMatrix();
-    QVector4D ray_eye_2 = view.inverted()*ray_eye;
-    QVector4D ray_wor = QVector4D(ray_eye_2.x(), ray_eye_2.y(), ray_eye_2.z(), 1.0);
-    return ray_wor;
+    instances_dirty = true;
+    positions_dirty = true;
+    nodes_dirty = true;
+    bounds_stale = false;
+    pending_scene.clear();
+
+    pause();
+    current_frame = 0;
+    emit trajectoryChanged(getFrameCount());
 }
 
-void MolViewer::ray_cating(int xpos, int ypos){
-    /*
-     *用于3D拾取(3D-picking)的ray-cating方法
-     *ray_wor为从摄像机视角出发到被点击的屏幕坐标的方向向量，通过判断该向量延长后是否与物体相交(例如通过与物体中心坐标的距离判断)，可以拾取物体
-     */
-    QVector4D ray_wor = ScreenCoordinate2_WorldCoordinate(xpos,ypos);
-    // camera.Front = glm::vec3(ray_wor.x, ray_wor.y, ray_wor.z);
-
-    float shortest_distance = 10000.0;
-    int selected_object = -1;
-    float selected_radius;
-    int selected_SectorCount;
-    int selected_StackCount;
-
-    glm::vec3 selected_position;
-
-    for(auto ball = balls_copy.begin(); ball != balls_copy.end(); ++ball){
-        glm::vec3 core = (*ball)->getPosition();
-        glm::vec3 pointer_vector = glm::normalize(glm::vec3(core.x-camera->position.x(), core.y-camera->position.y(), core.z-camera->position.z()));
-        glm::vec3 ray_vector = glm::normalize(glm::vec3(ray_wor.x(), ray_wor.y(), ray_wor.z()));
-
-        float distance = qSqrt(qPow((core.x-camera->position.x()), 2)+qPow(core.y-camera->position.y(), 2)+qPow((core.z-camera->position.z()), 2));
-        float radius = (*ball)->getRadius();
-        float angle = qTan(radius/distance);
-
-        float angle2 = glm::angle(pointer_vector, ray_vector);  //ray_casting与物体中点的夹角
-        if(angle2 <= angle || (PI-angle2) <=angle){
-            int object_no = (*ball)->getNo();
-            if(distance < shortest_distance){
-                selected_object = object_no;
-                selected_radius = (*ball)->getRadius();
-                selected_SectorCount = (*ball)->getSectorCount();
-                selected_StackCount = (*ball)->getStackCount();
-                selected_position = (*ball)->getPosition();
-                shortest_distance = distance;
-            }
+void MolViewer::setTrajectory(shared_ptr<Trajectory> frames){
+    if(!frames || frames->getAtomCount() != atom_instances.size())
+        return;
+    pause();
+    trajectory = frames;
+    current_frame = 0;
+    emit trajectoryChanged(getFrameCount());
+    setFrame(0);
+}
+
+void MolViewer::setFrame(int frame){
+    if(!trajectory || frame < 0 || frame >= getFrameCount() || trajectory->getAtomCount() != atom_instances.size())
+        return;
+    frame_positions.resize(3*atom_instances.size());
+    if(!trajectory->readFrame(frame, frame_positions.data()))
+        return;
+    current_frame = frame;
+
+    // 只改坐标: 原子中心, 键的端点; 两棵BVH等到CPU剔除时再重新拟合, 拓扑不变
+    ThreadPool& pool = ThreadPool::instance();
+    const float* xyz = frame_positions.data();
+    pool.parallelFor(0, atom_instances.size(), 8192, [this, xyz](size_t first, size_t last){
+        for(size_t i = first; i < last; ++i)
+            atom_instances[i].center = glm::vec3(xyz[3*i], xyz[3*i+1], xyz[3*i+2]);
+    });
+    pool.parallelFor(0, bond_instances.size(), 8192, [this](size_t first, size_t last){
+        for(size_t i = first; i < last; ++i){
+            BondInstance& bond = bond_instances[i];
+            bond.start = atom_instances[bond.first].center;
+            bond.end = atom_instances[bond.second].center;
         }
-    }
+    });
+
+    // GPU剔除直接读位置流, 只有CPU剔除需要重新分组上传
+    positions_dirty = true;
+    bounds_stale = true;
+    if(!use_GpuCulling())
+        instances_dirty = true;
+    hiz_stale = true;
+    emit frameChanged(frame);
+    update();
+}
 
-    if(selected_object != -1){
-        Sphere* sphere = new Sphere(selected_object, selected_radius, selected_SectorCount, selected_StackCount, selected_position, WHITE);
-        cout << "select " << selected_object << endl;
-        objects.erase(objects.begin()+selected_object);
-        objects.insert(objects.begin()+selected_object, sphere);
-    }
+void MolViewer::setNodeTransform(unsigned int node, const glm::mat4& local){
+    // 刚体移动一条链或一个配体只改一个矩阵, 下一帧传播到子节点并上传变了的那一段
+    if(node >= scene_graph.size())
+        return;
+    scene_graph.setTransform(node, local);
+    bounds_stale = true;
+    if(!use_GpuCulling())
+        instances_dirty = true;
+    hiz_stale = true;
     update();
 }
 
-MolViewer::~MolViewer(){
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
+void MolViewer::play(){
+    if(getFrameCount() > 1)
+        play_timer->start();
 }
 
-void MolViewer::initializeGL(){
-    this->initializeOpenGLFunctions();
+void MolViewer::pause(){
+    play_timer->stop();
+}
 
-    createShader();
-    glEnable(GL_DEPTH_TEST);
-    molShader.bind();
+bool MolViewer::isPlaying() const{
+    return play_timer->isActive();
 }
 
-void MolViewer::resizeGL(int w, int h){
-    glViewport(0, 0, w, h);
+void MolViewer::next_Frame(){
+    setFrame((current_frame+1) % getFrameCount());
 }
 
-void MolViewer::paintGL(){
-    if(!MolFilePath.empty() && MolFilePath != recentFile){
-        clear_all();
+void MolViewer::setRenderMode(RenderMode mode){
+    render_mode = mode;
+    instances_dirty = true;     // 可能在CPU/GPU剔除之间切换
+    update();
+}
 
-        string suffix = MolFilePath.substr(MolFilePath.size()-4);
+void MolViewer::setCullMode(CullMode mode){
+    cull_mode = mode;
+    instances_dirty = true;
+    hiz_valid = false;
+    update();
+}
 
-        if(suffix == ".mol"){
-            mol = MiniRDKit::MolFileToMol(MolFilePath);
-        }else if(suffix == "mol2"){
-            mol = MiniRDKit::Mol2FileToMol(MolFilePath);
-        }else if(suffix == ".pdb"){
-            mol = MiniRDKit::PDBFileToMol(MolFilePath);
-        }
+void MolViewer::request_Pick(PickMode mode, const QRect& rect){
+    // 窗口坐标(y向下)换成ID缓冲的设备像素(y向上)
+    int ratio = devicePixelRatio();
+    QRect pixels(rect.x()*ratio, (height()-rect.y()-rect.height())*ratio, max(rect.width(), 1)*ratio, max(rect.height(), 1)*ratio);
+    pixels &= QRect(0, 0, width()*ratio, height()*ratio);
+    if(pixels.isEmpty())
+        return;
+
+    // ID缓冲过期时(相机或坐标刚变过, 例如播放轨迹)不为悬停重画整个场景, 改走BVH射线的精确求交
+    if(mode == PICK_HOVER && (id_stale || instances_dirty)){
+        int atom, bond;
+        ray_Pick(rect.x(), rect.y(), atom, bond);
+        show_Hover(atom, bond);
+        return;
+    }
 
-        vector<float> position_radius;
+    // 悬停不覆盖还没发出的点击和框选
+    if(mode != PICK_HOVER || pending_pick == PICK_NONE || pending_pick == PICK_HOVER){
+        pending_pick = mode;
+        pending_pixels = pixels;
+    }
+    // 正在读回时等它完成; 场景或实例还没画到屏幕上时等下一帧, 保证拾取的就是看到的
+    if(issued_pick != PICK_NONE || !gl_ready)
+        return;
+    if(instances_dirty || pending_scene){
+        update();
+        return;
+    }
+    makeCurrent();
+    issue_Pick(pending_pick, pending_pixels);
+    doneCurrent();
+}
 
-        for(auto i = mol->beginConformers(); i != mol->endConformers(); ++i){   // 汇总原子位置
-            MiniRDKit::POINT3D_VECT points = ((*i).get())->getPositions();
-            for(auto j = points.begin(); j!=points.end(); ++j){
-                // cout << (*j).x << " ," << (*j).y << " ," << (*j).z << "\n"
-                position_radius.push_back((*j).x);
-                position_radius.push_back((*j).y);
-                position_radius.push_back((*j).z);
-            }
-        }
+void MolViewer::issue_Pick(PickMode mode, const QRect& pixels){
+    // 需要GL上下文; 只把矩形读进PBO并插入栅栏, 结果由finish_Pick取回
+    pending_pick = PICK_NONE;
+    if(id_stale || id_width != width()*devicePixelRatio() || id_height != height()*devicePixelRatio())
+        draw_IdBuffer();
+
+    size_t size = size_t(pixels.width())*pixels.height()*sizeof(unsigned int);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, idPBO);
+    if(size > id_pbo_size){
+        id_pbo_size = size;
+        glBufferData(GL_PIXEL_PACK_BUFFER, id_pbo_size, nullptr, GL_STREAM_READ);
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, idFBO);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(pixels.x(), pixels.y(), pixels.width(), pixels.height(), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+
+    id_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    issued_pick = mode;
+    issued_pixels = pixels;
+    pick_timer->start();
+}
 
-        int counter = 1;
-        vector<unsigned int> all_atom_id;
-        for(auto i = mol->beginAtoms(); i!=mol->endAtoms(); ++i){      // 汇总原子质量
-            // cout << (*i)->getAtomicNum() <<" "<<  (*i)->getIdx() << endl;
-            unsigned int atom_id = (*i)->getIdx();
-            all_atom_id.push_back(atom_id);
-            auto pos = position_radius.begin();
-            position_radius.insert(pos+(4*counter-1), (*i)->getAtomicNum());
-            ++counter;
-        }
+void MolViewer::finish_Pick(){
+    if(issued_pick == PICK_NONE){
+        pick_timer->stop();
+        return;
+    }
+    makeCurrent();
+    // 读回期间到达的请求
+    if(collect_Pick() && pending_pick != PICK_NONE && !instances_dirty && !pending_scene)
+        issue_Pick(pending_pick, pending_pixels);
+    doneCurrent();
+}
 
-        int atom_num = position_radius.size();
-        float positions[atom_num];
-        copy(position_radius.begin(), position_radius.end(), positions);
-
-        vector<Sphere* > balls;
-        vector<Cylinder* > cylinders;
-
-        // 构建原子信息
-        Sphere hydrogen(0, 0.1f, 8, 4, glm::vec3(0.0f, 0.0f, 0.0f), GREEN);
-        Sphere carbon(0, 0.2f, 16, 8, glm::vec3(0.0f, 0.0f, 0.0f), RED);
-        Sphere nitrogen(0, 0.24f, 16, 8, glm::vec3(0.0f, 0.0f, 0.0f), GOLD1);
-        Sphere oxygen(0, 0.28f, 16, 8, glm::vec3(0.0f, 0.0f, 0.0f), BLUE);
-        Sphere fluorine(0, 0.32f, 16, 8, glm::vec3(0.0f, 0.0f, 0.0f), CYAN);
-        Sphere big_atom(0, 0.36f, 16, 8, glm::vec3(0.0f, 0.0f, 0.0f), GREY31);
-
-        for(int i=0; i<sizeof(positions)/sizeof(float); i+=4){
-            glm::vec3 pos = glm::vec3(positions[i],  positions[i+1],  positions[i+2]);
-            int no = i/4;
-            Sphere* ball;
-
-            if(positions[i+3]>9){
-                ball = new Sphere(big_atom);
-                ball->setNo(no);
-                ball->setPosition(pos);
-            }else if(positions[i+3]==9){
-                ball = new Sphere(fluorine);
-                ball->setNo(no);
-                ball->setPosition(pos);
-            }else if(positions[i+3]==8){
-                ball = new Sphere(oxygen);
-                ball->setNo(no);
-                ball->setPosition(pos);
-            }else if(positions[i+3]==7){
-                ball = new Sphere(nitrogen);
-                ball->setNo(no);
-                ball->setPosition(pos);
-            }else if(positions[i+3]==6){
-                ball = new Sphere(carbon);
-                ball->setNo(no);
-                ball->setPosition(pos);
-            }else{
-                ball = new Sphere(hydrogen);
-                ball->setNo(no);
-                ball->setPosition(pos);
-            }
-            balls.push_back(ball);
-        }
-        // 构建键信息
-        for(auto bond = mol->beginBonds(); bond!=mol->endBonds(); ++bond){
-            // cout << (*bond)->getBeginAtomIdx() << "," << (*bond)->getEndAtomIdx() << "\n";
-            int start_atom_idx = (*bond)->getBeginAtomIdx();
-            int end_atom_idx = (*bond)->getEndAtomIdx();
-            glm::vec3 start_point = glm::vec3(positions[start_atom_idx*4],  positions[start_atom_idx*4+1],  positions[start_atom_idx*4+2]);
-            glm::vec3 end_point = glm::vec3(positions[end_atom_idx*4],  positions[end_atom_idx*4+1],  positions[end_atom_idx*4+2]);
-            BondType bond_type = (*bond)->getBondType();
-
-            if(bond_type == MiniRDKit::Bond::DOUBLE){
-                build_Keys(MiniRDKit::Bond::DOUBLE, end_point, start_point, cylinders);
-
-                // }else if(bond_type == MiniRDKit::Bond::TRIPLE){
-
-            }else if (bond_type == MiniRDKit::Bond::AROMATIC){
-                auto start_atom = aromatic_map.find(start_atom_idx);
-                auto end_atom = aromatic_map.find(end_atom_idx);
-
-                if(start_atom == aromatic_map.end() && end_atom == aromatic_map.end()){
-                    build_Keys(MiniRDKit::Bond::SINGLE, end_point, start_point, cylinders);
-                    aromatic_map.insert({start_atom_idx, false});
-                    aromatic_map.insert({end_atom_idx, false});
-                }else if(start_atom == aromatic_map.end() && end_atom->second){
-                    build_Keys(MiniRDKit::Bond::SINGLE, end_point, start_point, cylinders);
-                    aromatic_map.insert({start_atom_idx, false});
-                }else if(start_atom == aromatic_map.end() && !end_atom->second){
-                    build_Keys(MiniRDKit::Bond::DOUBLE, end_point, start_point, cylinders);
-                    aromatic_map.insert({start_atom_idx, true});
-                    aromatic_map[end_atom_idx] = true;
-                }else if(end_atom == aromatic_map.end() && start_atom->second){
-                    build_Keys(MiniRDKit::Bond::SINGLE, end_point, start_point, cylinders);
-                    aromatic_map.insert({end_atom_idx, false});
-                }else if(end_atom == aromatic_map.end() && !start_atom->second){
-                    build_Keys(MiniRDKit::Bond::DOUBLE, end_point, start_point, cylinders);
-                    aromatic_map.insert({end_atom_idx, true});
-                    aromatic_map[start_atom_idx] = true;
-                }else if(start_atom != aromatic_map.end() && end_atom != aromatic_map.end() && (start_atom->second || end_atom->second)){
-                    build_Keys(MiniRDKit::Bond::SINGLE, end_point, start_point, cylinders);
-                    aromatic_map[start_atom_idx] = true;
-                    aromatic_map[end_atom_idx] = true;
-                }else{
-                    build_Keys(MiniRDKit::Bond::DOUBLE, end_point, start_point, cylinders);
-                    aromatic_map[start_atom_idx] = true;
-                    aromatic_map[end_atom_idx] = true;
-                }
-            }else{
-                build_Keys(MiniRDKit::Bond::SINGLE, end_point, start_point, cylinders);
+bool MolViewer::collect_Pick(){
+    // 需要GL上下文; 栅栏未到时立即返回false, 不等待GPU
+    if(issued_pick == PICK_NONE)
+        return true;
+    if(glClientWaitSync(id_fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        return false;
+    glDeleteSync(id_fence);
+    id_fence = nullptr;
+    pick_timer->stop();
+
+    PickMode mode = issued_pick;
+    issued_pick = PICK_NONE;
+    size_t count = size_t(issued_pixels.width())*issued_pixels.height();
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, idPBO);
+    const unsigned int* ids = (const unsigned int*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, count*sizeof(unsigned int), GL_MAP_READ_BIT);
+    if(ids != nullptr){
+        apply_Pick(mode, ids, count);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return true;
+}
+
+void MolViewer::cancel_Pick(){
+    // 换场景后编号失效, 丢弃正在读回和等待的请求
+    if(id_fence)
+        glDeleteSync(id_fence);
+    id_fence = nullptr;
+    issued_pick = PICK_NONE;
+    pending_pick = PICK_NONE;
+    pick_timer->stop();
+    id_stale = true;
+}
+
+void MolViewer::apply_Pick(PickMode mode, const unsigned int* ids, size_t count){
+    if(mode == PICK_RECTANGLE){
+        // 矩形内所有可见的原子加入选择; 键的高亮由两端原子决定, 不单独计入
+        size_t selected = 0;
+        for(size_t i = 0; i < count; ++i){
+            unsigned int value = ids[i];
+            if(value != 0 && !(value & PICK_BOND_BIT) && value-1 < atom_instances.size()){
+                selection.set(value-1, true);
+                ++selected;
             }
         }
+        if(selected > 0)
+            update();
+        return;
+    }
 
-        float system_center_x = 0.0f;
-        float system_center_y = 0.0f;
-        float system_center_z = 0.0f;
-        // 构建原子
-        for(Sphere* ball:balls){
-            build_GLobject(ball, total_vertexcount, total_indexcount);
-            objects.push_back(ball);
-            glm::vec3 ball_position = ball->getPosition();
-            system_center_x += ball_position.x;
-            system_center_y += ball_position.y;
-            system_center_z += ball_position.z;
+    int atom = -1;
+    int bond = -1;
+    unsigned int value = ids[0];
+    if(value & PICK_BOND_BIT){
+        value &= ~PICK_BOND_BIT;
+        if(value != 0 && value-1 < bond_instances.size())
+            bond = value-1;
+    }else if(value != 0 && value-1 < atom_instances.size()){
+        atom = value-1;
+    }
+
+    if(mode == PICK_CLICK){
+        if(atom >= 0){
+            selection.toggle(atom);                 // 下一帧只上传这一个字
+        }else if(bond >= 0){
+            // 键的高亮由两端原子决定, 两端一起切换
+            const BondInstance& instance = bond_instances[bond];
+            bool selected = !(selection.test(instance.first) && selection.test(instance.second));
+            selection.set(instance.first, selected);
+            selection.set(instance.second, selected);
         }
+        if(atom >= 0 || bond >= 0)
+            update();
+        return;
+    }
+    show_Hover(atom, bond);
+}
 
-        system_center = QVector3D(system_center_x/balls.size(), system_center_y/balls.size(), system_center_z/balls.size());
-        camera->front = QVector3D(system_center.x()-camera->position.x(), system_center.y()-camera->position.y(), system_center.z()-camera->position.z());
+Ray MolViewer::screen_Ray(int xpos, int ypos){
+    // 把屏幕坐标在近/远裁剪面上的两点反投影回世界坐标, 连线即拾取射线
+    float x = (2.0f*xpos)/this->width() - 1.0f;
+    float y = 1.0f - (2.0f*ypos)/this->height();
+    QMatrix4x4 inverse = (global_projection*camera->getViewMatrix()).inverted();
+    QVector4D near_point = inverse*QVector4D(x, y, -1.0f, 1.0f);
+    QVector4D far_point = inverse*QVector4D(x, y, 1.0f, 1.0f);
+    near_point /= near_point.w();
+    far_point /= far_point.w();
+    glm::vec3 origin(near_point.x(), near_point.y(), near_point.z());
+    glm::vec3 target(far_point.x(), far_point.y(), far_point.z());
+    return Ray(origin, target-origin);
+}
 
-        // 构建键
-        for(Cylinder* cylinder:cylinders){
-            build_GLobject(cylinder, total_vertexcount, total_indexcount);
-            objects.push_back(cylinder);
-        }
-        recentFile = MolFilePath;
-        balls_copy = balls;
+void MolViewer::ray_Pick(int xpos, int ypos, int& atom, int& bond){
+    /*
+     *CPU上的精确拾取, 不需要GL上下文, 也不必重画ID缓冲
+     *沿射线由近及远遍历原子和键的BVH, 只对包围盒相交的叶子做精确的球/胶囊体求交, 复杂度约为O(log N)
+     *先求最近的原子, 再以其距离为上限求键, 因此只有挡在原子前面的键才会被选中
+     */
+    if(bounds_stale)
+        refit_Bounds();
+    Ray ray = screen_Ray(xpos, ypos);
+    float t = 1e30f;
+    atom = atom_bvh.raycast(ray, [this, &ray](unsigned int i, float& nearest){
+        const AtomInstance& instance = atom_instances[i];
+        float hit;
+        if(!intersect_Sphere(ray, scene_graph.toWorld(i, instance.center), instance.radius, hit) || hit >= nearest)
+            return false;
+        nearest = hit;
+        return true;
+    }, t);
+    bond = bond_bvh.raycast(ray, [this, &ray](unsigned int i, float& nearest){
+        // 双键的两条实例各偏移|offset|, 与包围盒一样放大半径
+        const BondInstance& instance = bond_instances[i];
+        glm::vec3 start = scene_graph.toWorld(instance.first, instance.start);
+        glm::vec3 end = scene_graph.toWorld(instance.second, instance.end);
+        float hit;
+        if(!intersect_Capsule(ray, start, end, instance.radius + fabs(instance.offset), hit) || hit >= nearest)
+            return false;
+        nearest = hit;
+        return true;
+    }, t);
+    if(bond >= 0)
+        atom = -1;
+}
+
+glm::vec3 MolViewer::drag_Point(int xpos, int ypos){
+    // 光标射线与过drag_anchor且垂直视线的平面的交点
+    Ray ray = screen_Ray(xpos, ypos);
+    glm::vec3 front = glm::normalize(glm::vec3(camera->front.x(), camera->front.y(), camera->front.z()));
+    float denom = glm::dot(ray.direction, front);
+    if(fabs(denom) < 1e-6f)
+        return drag_anchor;
+    return ray.origin + ray.direction * (glm::dot(drag_anchor - ray.origin, front) / denom);
+}
+
+void MolViewer::show_Hover(int atom, int bond){
+    if(atom == hovered_atom && bond == hovered_bond)
+        return;
+    hovered_atom = atom;
+    hovered_bond = bond;
+    if(atom >= 0){
+        emit hoverChanged(atom_Label(atom));
+    }else if(bond >= 0){
+        const BondInstance& instance = bond_instances[bond];
+        emit hoverChanged(atom_Label(instance.first) + "-" + atom_Label(instance.second));
+    }else{
+        emit hoverChanged(QString());
     }
+}
+
+QString MolViewer::atom_Label(unsigned int atom) const{
+    // 元素和原子编号, PDB等带残基信息时附上残基名, 链和残基号, 如"N12 ALA A3"
+    if(atom >= atom_table.size())
+        return QString("#%1").arg(atom);
+    QString label = QString("%1%2").arg(element_Symbol(atom_table.atomic_number[atom])).arg(atom_table.serial[atom]);
+    if(atom_table.residue_name[atom][0] != '\0')
+        label += QString(" %1 %2%3").arg(atom_table.residue_name[atom].data()).arg(QChar(atom_table.chain[atom])).arg(atom_table.residue_seq[atom]);
+    return label;
+}
+
+MolViewer::~MolViewer(){
+    clear_all();
+    if(!gl_ready)
+        return;
+    makeCurrent();
+    glDeleteBuffers(1, &frameUBO);
+    glDeleteBuffers(1, &selectionBuffer);
+    glDeleteBuffers(1, &positionBuffer);
+    for(GLsync fence: position_fences){
+        if(fence)
+            glDeleteSync(fence);
+    }
+    glDeleteBuffers(1, &sceneVBO);
+    glDeleteBuffers(1, &sceneEBO);
+    glDeleteBuffers(1, &indirectBuffer);
+    glDeleteVertexArrays(1, &atomVAO);
+    glDeleteBuffers(1, &atomInstanceVBO);
+    glDeleteVertexArrays(1, &atomImpostorVAO);
+    glDeleteVertexArrays(1, &bondVAO);
+    glDeleteBuffers(1, &bondInstanceVBO);
+    glDeleteVertexArrays(1, &bondImpostorVAO);
+    glDeleteBuffers(1, &atomSourceBuffer);
+    glDeleteBuffers(1, &bondSourceBuffer);
+    glDeleteBuffers(1, &atomVisibleBuffer);
+    glDeleteBuffers(1, &bondVisibleBuffer);
+    glDeleteBuffers(1, &cullCommandBuffer);
+    glDeleteVertexArrays(1, &atomCulledVAO);
+    glDeleteVertexArrays(1, &bondCulledVAO);
+    glDeleteFramebuffers(1, &hizDepthFBO);
+    glDeleteTextures(1, &hizDepthTexture);
+    glDeleteTextures(1, &hizTexture);
+    if(id_fence)
+        glDeleteSync(id_fence);
+    glDeleteFramebuffers(1, &idFBO);
+    glDeleteTextures(1, &idTexture);
+    glDeleteRenderbuffers(1, &idDepthBuffer);
+    glDeleteBuffers(1, &idPBO);
+    glDeleteVertexArrays(1, &coordinateVAO);
+    glDeleteBuffers(1, &coordinateVBO);
+    doneCurrent();
+}
+
+void MolViewer::initializeGL(){
+    // 间接多重绘制, SSBO和计算着色器都要求4.3; 驱动给不了时不能调用任何GL函数, 提示后保持空白
+    if(!this->initializeOpenGLFunctions()){
+        QSurfaceFormat format = context()->format();
+        QString message = QString("OpenGL 4.3 core profile is required, the driver provides %1.%2.")
+                          .arg(format.majorVersion()).arg(format.minorVersion());
+        qDebug() << message;
+        QMessageBox::critical(this, "OpenGL", message);
+        return;
+    }
+    gl_ready = true;
+
+    createShader(molShader, ":/shaders/lightedsphere.vs", ":/shaders/lightedsphere.fs");
+    createShader(atomShader, ":/shaders/instancedsphere.vs", ":/shaders/instancedlighted.fs");
+    createShader(bondShader, ":/shaders/instancedcylinder.vs", ":/shaders/instancedlighted.fs");
+    createShader(atomImpostorShader, ":/shaders/sphereimpostor.vs", ":/shaders/sphereimpostor.fs");
+    createShader(bondImpostorShader, ":/shaders/cylinderimpostor.vs", ":/shaders/cylinderimpostor.fs");
+    createShader(atomCulledShader, ":/shaders/culledsphere.vs", ":/shaders/instancedlighted.fs");
+    createShader(bondCulledShader, ":/shaders/culledcylinder.vs", ":/shaders/instancedlighted.fs");
+    createShader(atomIdShader, ":/shaders/instancedsphere.vs", ":/shaders/pickid.fs");
+    createShader(bondIdShader, ":/shaders/instancedcylinder.vs", ":/shaders/pickid.fs");
+    createShader(atomImpostorIdShader, ":/shaders/sphereimpostor.vs", ":/shaders/sphereimpostorid.fs");
+    createShader(bondImpostorIdShader, ":/shaders/cylinderimpostor.vs", ":/shaders/cylinderimpostorid.fs");
+    createShader(atomCulledIdShader, ":/shaders/culledsphere.vs", ":/shaders/pickid.fs");
+    createShader(bondCulledIdShader, ":/shaders/culledcylinder.vs", ":/shaders/pickid.fs");
+    // 网格着色器按合并缓冲的顶点格式解码法向
+    QOpenGLShaderProgram* mesh_shaders[] = {&atomShader, &bondShader, &atomCulledShader, &bondCulledShader,
+                                            &atomIdShader, &bondIdShader, &atomCulledIdShader, &bondCulledIdShader};
+    for(QOpenGLShaderProgram* shader: mesh_shaders){
+        shader->bind();
+        shader->setUniformValue("packedNormals", scene_buffer.getFormat() == VERTEX_PACKED);
+    }
+    createComputeShader(cullShader, ":/shaders/cull.cs");
+    createComputeShader(hizShader, ":/shaders/hiz.cs");
+    glEnable(GL_DEPTH_TEST);
+    build_FrameUniforms();
+
+    // 所有网格打包进一个VBO/EBO, 每种形状预先细分出LOD_LEVELS个级别; 细分结果来自共享的网格缓存
+    MeshCache& meshes = MeshCache::instance();
+    for(int l = 0; l < LOD_LEVELS; ++l){
+        sphereLods[l] = build_GLobject(meshes.sphere(1.0f, SPHERE_LOD_SECTORS[l], SPHERE_LOD_STACKS[l]));
+        cylinderLods[l] = build_GLobject(meshes.cylinder(1.0f, CYLINDER_LOD_SECTORS[l], 1));
+    }
+    upload_SceneBuffer();
+
+    build_AtomInstances();
+    build_BondInstances();
+    build_GpuCulling();
+    build_Selection();
+    build_Positions();
+    build_NodeMatrices();
+    build_IdBuffer();
+    create_CoordinateSystem(glm::vec3(-10.0f), glm::vec3(10.0f));
+}
+
+void MolViewer::resizeGL(int w, int h){
+    if(!gl_ready)
+        return;
+    glViewport(0, 0, w, h);
+}
+
+void MolViewer::paintGL(){
+    if(!gl_ready)
+        return;
+    if(pending_scene)
+        apply_Scene();
 
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -287,33 +536,77 @@ void MolViewer::paintGL(){
     global_projection = projection;
 
     QMatrix4x4 view = camera->getViewMatrix();
-    molShader.setUniformValue("projection", projection);
-    molShader.setUniformValue("view", view);
+    // 只有相机, 实例, 坐标或节点变换变了, 屏幕上的编号才会变; 单纯的重绘(如选择高亮)不必重画ID缓冲
+    QMatrix4x4 view_projection = projection*view;
+    if(view_projection != id_view_projection || instances_dirty || positions_dirty || scene_graph.isDirty()){
+        id_view_projection = view_projection;
+        id_stale = true;
+    }
+    update_FrameUniforms(view);
+    upload_Selection();
+    if(positions_dirty)
+        upload_Positions();
+    upload_NodeMatrices();
+    bool gpu_culling = use_GpuCulling();
+    if(gpu_culling)
+        cull_OnGpu(view);
+    else
+        update_Visibility(view);
+
+    draw_Molecule(false);
+    fence_Positions();
 
-    int obj_index = 0;
-    for(auto vao:vaos){
-        glBindVertexArray(vao);
+    molShader.bind();
+    draw_CoordinateSystem();
 
-        // world transformation
-        glm::mat4 tmp_model = glm::mat4(1.0f);
-        float angle = 0.0f;
-        tmp_model = glm::rotate(tmp_model, glm::radians(angle), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = QMatrix4x4(glm::value_ptr(tmp_model)).transposed();
-        molShader.setUniformValue("model", model);
+    if(gpu_culling)
+        update_HiZ();
 
-        GraphicObject* obj = objects[obj_index];
-        QVector3D object_color = glm2Qvector(obj->getColor());
+    // 上下文已是当前的, 顺带取回在途的读回, 再发出等待本帧画出的拾取请求
+    collect_Pick();
+    if(pending_pick != PICK_NONE && issued_pick == PICK_NONE)
+        issue_Pick(pending_pick, pending_pixels);
+}
 
-        molShader.setUniformValue("objectColor", object_color);
-        molShader.setUniformValue("lightColor", lightColor);
-        // light properties
-        molShader.setUniformValue("lightPos", lightPos);
-        molShader.setUniformValue("viewPos", camera->position);
+void MolViewer::draw_Molecule(bool pick_ids){
+    // 使用本帧剔除后的实例; pick_ids时换成写编号的片段着色器, 几何与屏幕上完全一致
+    // 所有原子一次实例化绘制
+    if(render_mode == IMPOSTOR_MODE){
+        // 每个原子一个面向相机的四边形, 由片段着色器光线求交得到精确的球面和深度
+        (pick_ids ? atomImpostorIdShader : atomImpostorShader).bind();
+        glBindVertexArray(atomImpostorVAO);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, atom_draw_instances.size());
+    }else if(use_GpuCulling()){
+        // 命令和实例编号都由cull.cs写入
+        (pick_ids ? atomCulledIdShader : atomCulledShader).bind();
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, atomSourceBuffer);
+        glBindVertexArray(atomCulledVAO);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, cullCommandBuffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, mesh_IndexType(), nullptr, LOD_LEVELS, 0);
+    }else{
+        (pick_ids ? atomIdShader : atomShader).bind();
+        glBindVertexArray(atomVAO);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, mesh_IndexType(), (void*)(atom_command_first*sizeof(DrawElementsIndirectCommand)), atom_command_count, 0);
+    }
 
-        glDrawElements(GL_TRIANGLES, total_indexcount*3, GL_UNSIGNED_INT, (void*)0);
-        obj_index+=1;
+    // 所有键一次实例化绘制
+    if(render_mode == IMPOSTOR_MODE){
+        (pick_ids ? bondImpostorIdShader : bondImpostorShader).bind();
+        glBindVertexArray(bondImpostorVAO);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, bond_draw_instances.size());
+    }else if(use_GpuCulling()){
+        (pick_ids ? bondCulledIdShader : bondCulledShader).bind();
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, bondSourceBuffer);
+        glBindVertexArray(bondCulledVAO);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, cullCommandBuffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, mesh_IndexType(), (void*)(LOD_LEVELS*sizeof(DrawElementsIndirectCommand)), LOD_LEVELS, 0);
+    }else{
+        (pick_ids ? bondIdShader : bondShader).bind();
+        glBindVertexArray(bondVAO);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, mesh_IndexType(), (void*)(bond_command_first*sizeof(DrawElementsIndirectCommand)), bond_command_count, 0);
     }
-    create_CoordinateSystem();
 }
 
 void MolViewer::keyPressEvent(QKeyEvent *event){
@@ -332,11 +625,30 @@ void MolViewer::keyReleaseEvent(QKeyEvent *event){
 }
 
 void MolViewer::mousePressEvent(QMouseEvent *event){
-    if(event->button() == Qt::LeftButton){
+    if(event->button() == Qt::LeftButton && (event->modifiers() & Qt::ControlModifier)){
+        // Ctrl+拖动: 移动光标下原子所在的残基, 同时按Shift则移动整条链
+        int atom, bond;
+        ray_Pick(event->pos().x(), event->pos().y(), atom, bond);
+        if(atom < 0 && bond >= 0)
+            atom = bond_instances[bond].first;
+        if(atom < 0 || size_t(atom) >= scene_graph.getAtomNodes().size())
+            return;
+        int node = scene_graph.getAtomNode(atom);
+        if((event->modifiers() & Qt::ShiftModifier) && scene_graph.getNode(node).parent >= 0)
+            node = scene_graph.getNode(node).parent;
+        drag_node = node;
+        drag_local = scene_graph.getTransform(node);
+        drag_anchor = scene_graph.toWorld(atom, atom_instances[atom].center);
+    }else if(event->button() == Qt::LeftButton && (event->modifiers() & Qt::ShiftModifier)){
+        // Shift+拖动: 框选矩形内所有可见的原子
+        rubber_origin = event->pos();
+        rubber_band->setGeometry(QRect(rubber_origin, QSize()));
+        rubber_band->show();
+    }else if(event->button() == Qt::LeftButton){
         m_bLeftPressed = true;
         m_lastPos = event->pos();                  // 2d viewport 坐标
         last_LeftButton_click_time = QDateTime::currentMSecsSinceEpoch();
-        ray_cating(m_lastPos.x(), m_lastPos.y());
+        request_Pick(PICK_CLICK, QRect(m_lastPos, QSize(1, 1)));
     }else if(event->button() == Qt::RightButton){
 
     }else if(event->button() == Qt::MidButton){
@@ -346,21 +658,8 @@ void MolViewer::mousePressEvent(QMouseEvent *event){
 
 void MolViewer::mouseDoubleClickEvent(QMouseEvent *event){
     cout << "Double Clicked!" << endl;
-    if(all_selected){
-        for(Sphere* ball: balls_copy){
-            Sphere* sphere = new Sphere(*ball);
-            objects.erase(objects.begin()+ball->getNo());
-            objects.insert(objects.begin()+ball->getNo(), sphere);
-        }
-        all_selected = false;
-    }else{
-        all_selected = true;
-        for(Sphere* ball: balls_copy){
-            Sphere* sphere = new Sphere(ball->getNo(), ball->getRadius(), ball->getSectorCount(), ball->getStackCount(), ball->getPosition(), WHITE);
-            objects.erase(objects.begin()+ball->getNo());
-            objects.insert(objects.begin()+ball->getNo(), sphere);
-        }
-    }
+    all_selected = !all_selected;
+    selection.setAll(all_selected);     // 只改位集, 实例数据和LOD分组不变
 
     update();
 }
@@ -369,6 +668,11 @@ void MolViewer::mouseReleaseEvent(QMouseEvent *event){
     Q_UNUSED(event);
     if(event->button() == Qt::LeftButton){
         m_bLeftPressed = false;
+        drag_node = -1;
+        if(rubber_band->isVisible()){
+            rubber_band->hide();
+            request_Pick(PICK_RECTANGLE, rubber_band->geometry());
+        }
     }
 }
 
@@ -376,6 +680,25 @@ void MolViewer::mouseMoveEvent(QMouseEvent *event){
     int xpos = event->pos().x();
     int ypos = event->pos().y();
 
+    if(rubber_band->isVisible()){
+        rubber_band->setGeometry(QRect(rubber_origin, event->pos()).normalized());
+        return;
+    }
+    if(drag_node >= 0){
+        // 平移量在世界空间, 换到父节点的坐标系后左乘到按下时的局部矩阵上
+        glm::vec3 delta = drag_Point(xpos, ypos) - drag_anchor;
+        const SceneNode& node = scene_graph.getNode(drag_node);
+        glm::mat4 parent = node.parent >= 0 ? scene_graph.getNode(node.parent).world : glm::mat4(1.0f);
+        glm::mat4 move = glm::inverse(parent) * glm::translate(glm::mat4(1.0f), delta) * parent;
+        setNodeTransform(drag_node, move * drag_local);
+        return;
+    }
+    // 未按下左键时只做悬停拾取, 按住拖动才旋转
+    if(!m_bLeftPressed){
+        request_Pick(PICK_HOVER, QRect(event->pos(), QSize(1, 1)));
+        return;
+    }
+
     if(firstMouse){
         m_lastPos = event->pos();
         firstMouse = false;
@@ -417,47 +740,92 @@ QMatrix4x4 MolViewer::glm2QMatrix(glm::mat4 matrix){
     return QMatrix4x4(glm::value_ptr(matrix)).transposed();
 }
 
-bool MolViewer::createShader(){
-    bool success = molShader.addShaderFromSourceFile(QOpenGLShader::Vertex, ":/shaders/lightedsphere.vs");
+static bool append_ShaderFile(const QString& path, QByteArray& source){
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)){
+        qDebug() << "cannot open shader" << path;
+        return false;
+    }
+    source += file.readAll();
+    return true;
+}
+
+// 共用的声明只定义一次, 插在版本行之后, 布局和编码不会在各着色器之间走样:
+// frame.glsl(FrameUniforms块)给所有顶点/片段着色器, common.glsl(位置流, 节点矩阵, 选择位集和法向解码)
+// 给4.3的着色器; 4.2的着色器没有SSBO, 只插入前者
+static bool add_ShaderFile(QOpenGLShaderProgram& shader, QOpenGLShader::ShaderType type, const QString& path){
+    QByteArray source;
+    if(!append_ShaderFile(path, source))
+        return false;
+    int version_end = source.indexOf('\n');
+    QByteArray shared;
+    if(version_end >= 0){
+        if(type != QOpenGLShader::Compute && !append_ShaderFile(":/shaders/frame.glsl", shared))
+            return false;
+        if(source.startsWith("#version 430") && !append_ShaderFile(":/shaders/common.glsl", shared))
+            return false;
+    }
+    // #line让编译日志里的行号仍对应原文件
+    if(!shared.isEmpty())
+        source = source.left(version_end+1) + shared + "#line 2\n" + source.mid(version_end+1);
+    return shader.addShaderFromSourceCode(type, source);
+}
+
+bool MolViewer::createShader(QOpenGLShaderProgram& shader, const QString& vertexPath, const QString& fragmentPath){
+    bool success = add_ShaderFile(shader, QOpenGLShader::Vertex, vertexPath);
     if (!success) {
-        qDebug() << "shaderProgram addShaderFromSourceFile failed!" << molShader.log();
+        qDebug() << "shaderProgram addShaderFromSourceFile failed!" << shader.log();
         return success;
     }
 
-    success = molShader.addShaderFromSourceFile(QOpenGLShader::Fragment, ":/shaders/lightedsphere.fs");
+    success = add_ShaderFile(shader, QOpenGLShader::Fragment, fragmentPath);
     if (!success) {
-        qDebug() << "shaderProgram addShaderFromSourceFile failed!" << molShader.log();
+        qDebug() << "shaderProgram addShaderFromSourceFile failed!" << shader.log();
         return success;
     }
 
-    success = molShader.link();
+    success = shader.link();
     if(!success) {
-        qDebug() << "shaderProgram link failed!" << molShader.log();
+        qDebug() << "shaderProgram link failed!" << shader.log();
     }
 
     return success;
 }
 
-void MolViewer::clear_all(){
-    for(const unsigned int vao:vaos){
-        glDeleteVertexArrays(1, &vao);
+bool MolViewer::createComputeShader(QOpenGLShaderProgram& shader, const QString& computePath){
+    bool success = add_ShaderFile(shader, QOpenGLShader::Compute, computePath);
+    if (!success) {
+        qDebug() << "shaderProgram addShaderFromSourceFile failed!" << shader.log();
+        return success;
     }
-    vaos.clear();
-    for(const unsigned int vbo:vbos){
-        glDeleteBuffers(1, &vbo);
+
+    success = shader.link();
+    if(!success) {
+        qDebug() << "shaderProgram link failed!" << shader.log();
     }
-    vbos.clear();
-    glDeleteBuffers(1, &EBO);
 
-    mol = nullptr;
-    objects.clear();
-    total_vertexcount = 0;
-    total_indexcount = 0;
+    return success;
+}
 
-    aromatic_map.clear();
+void MolViewer::clear_all(){
+    delete mol;
+    mol = nullptr;
+    atom_table.clear();
+    bond_table.clear();
+    atom_instances.clear();
+    bond_instances.clear();
+    atom_bvh.clear();
+    bond_bvh.clear();
+    scene_graph.clear();
+    drag_node = -1;
+    nodes_dirty = true;
+    selection.clear();
+    trajectory.reset();
+    current_frame = 0;
 
     firstMouse = true;
     all_selected = false;
+    hovered_atom = hovered_bond = -1;
 }
 
 uint MolViewer::loadTexture(const QString& path){
@@ -479,127 +847,635 @@ uint MolViewer::loadTexture(const QString& path){
     return textureID;
 }
 
-void MolViewer::build_GLobject(GraphicObject *object, int &total_vertexcount, int &total_indexcount){
-    int vertexcount = object->getInterleavedVertexCount();
-    const float* v = object->getInterleavedVertices();
+MeshRange MolViewer::build_GLobject(const shared_ptr<const GraphicObject>& mesh){
+    // 只追加到合并缓冲, 由upload_SceneBuffer一次性上传; 同一网格只追加一次
+    return scene_buffer.add(mesh);
+}
 
-    float vertices[vertexcount*8];
-    for(int i=0; i<vertexcount; i++){
-        for(int j=0; j<8; ++j){
-            vertices[i*8+j] = v[i*8+j];
-        }
+void MolViewer::upload_SceneBuffer(){
+    if(sceneVBO == 0){
+        glGenBuffers(1, &sceneVBO);
+        glGenBuffers(1, &sceneEBO);
     }
+    glBindBuffer(GL_ARRAY_BUFFER, sceneVBO);
+    glBufferData(GL_ARRAY_BUFFER, scene_buffer.getVertexSize(), scene_buffer.getVertices(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sceneEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, scene_buffer.getIndexSize(), scene_buffer.getIndices(), GL_STATIC_DRAW);
+
+    // 数据已在显存中: 释放暂存数组和各网格的CPU数组, 只保留计数和区间; 再次请求网格时由MeshCache重新生成
+    MeshCache& meshes = MeshCache::instance();
+    for(const shared_ptr<const GraphicObject>& mesh: scene_buffer.getMeshes())
+        meshes.releaseArrays(mesh);
+    scene_buffer.releaseArrays();
+}
 
-    int indexcount = object->getTriangleCount();
-    const unsigned int* index = object->getIndices();
+void MolViewer::set_MeshAttributes(){
+    // 作用于当前绑定的VAO, 顶点和索引都来自合并缓冲
+    glBindBuffer(GL_ARRAY_BUFFER, sceneVBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sceneEBO);
+    int stride = scene_buffer.getVertexStride();
+    if(scene_buffer.getFormat() == VERTEX_PACKED){
+        // 法向只有两个分量, 着色器收到的z为0, 由decodeNormal还原
+        glVertexAttribPointer(0, 3, GL_HALF_FLOAT, false, stride, (void*)offsetof(PackedVertex, position));
+        glVertexAttribPointer(1, 2, GL_SHORT, true, stride, (void*)offsetof(PackedVertex, normal));
+    }else{
+        glVertexAttribPointer(0, 3, GL_FLOAT, false, stride, (void*)0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, false, stride, (void*)(sizeof(float)*3));
+    }
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+}
 
-    unsigned int indices[indexcount*3];
-    for(int j = 0; j<indexcount; j++){
-        for(int k=0;k<3;k++){
-            indices[j*3 + k] = index[j*3 + k];
-        }
+GLenum MolViewer::mesh_IndexType() const{
+    return scene_buffer.hasShortIndices() ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+void MolViewer::update_DrawCommands(){
+    // 每个LOD级别一条间接绘制命令, 实例区间由baseInstance指定; 原子命令在前, 键命令在后
+    draw_commands.clear();
+    atom_command_first = draw_commands.size();
+    for(int l = 0; l < LOD_LEVELS; ++l){
+        const MeshRange& mesh = sphereLods[l];
+        draw_commands.push_back({mesh.indexCount, atom_buckets.count[l], mesh.firstIndex, mesh.baseVertex, atom_buckets.first[l]});
     }
+    atom_command_count = draw_commands.size() - atom_command_first;
 
-    total_vertexcount += vertexcount;
-    total_indexcount += indexcount;
+    bond_command_first = draw_commands.size();
+    for(int l = 0; l < LOD_LEVELS; ++l){
+        const MeshRange& mesh = cylinderLods[l];
+        draw_commands.push_back({mesh.indexCount, bond_buckets.count[l], mesh.firstIndex, mesh.baseVertex, bond_buckets.first[l]});
+    }
+    bond_command_count = draw_commands.size() - bond_command_first;
 
-    unsigned int VBO, EBO, VAO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+    if(indirectBuffer == 0)
+        glGenBuffers(1, &indirectBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, draw_commands.size()*sizeof(DrawElementsIndirectCommand), draw_commands.data(), GL_DYNAMIC_DRAW);
+}
 
-    vaos.push_back(VAO);
+void MolViewer::build_AtomInstances(){
+    // 单位球在合并缓冲中只有一份, 原子的位置/半径/颜色都放在实例缓冲中
+    glGenVertexArrays(1, &atomVAO);
+    glBindVertexArray(atomVAO);
+    set_MeshAttributes();
+    glGenBuffers(1, &atomInstanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, atomInstanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
+    set_AtomInstanceAttributes();
+
+    // impostor模式不需要网格顶点, 四边形角点由gl_VertexID生成
+    glGenVertexArrays(1, &atomImpostorVAO);
+    glBindVertexArray(atomImpostorVAO);
+    set_AtomInstanceAttributes();
+
+    glBindVertexArray(0);
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    glBindVertexArray(VAO);
+void MolViewer::set_AtomInstanceAttributes(){
+    // 作用于当前绑定的VAO, 数据来自atomInstanceVBO
+    glBindBuffer(GL_ARRAY_BUFFER, atomInstanceVBO);
+    GLsizei stride = sizeof(AtomInstance);
+    glVertexAttribPointer(2, 4, GL_FLOAT, false, stride, (void*)offsetof(AtomInstance, center));
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glVertexAttribPointer(3, 3, GL_FLOAT, false, stride, (void*)offsetof(AtomInstance, color));
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+    glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, stride, (void*)offsetof(AtomInstance, id));
+    glEnableVertexAttribArray(4);
+    glVertexAttribDivisor(4, 1);
+}
 
-    vbos.push_back(VBO);
+void MolViewer::upload_AtomInstances(){
+    // 上传按LOD分组后的实例
+    glBindBuffer(GL_ARRAY_BUFFER, atomInstanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, atom_draw_instances.size()*sizeof(AtomInstance), atom_draw_instances.data(), GL_DYNAMIC_DRAW);
+}
 
-    glGenBuffers(1, &EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+void MolViewer::build_BondInstances(){
+    // 单位圆柱(半径1, 高1, 沿z轴)在合并缓冲中只有一份, 键的朝向在顶点着色器中由两端点求出
+    glGenVertexArrays(1, &bondVAO);
+    glBindVertexArray(bondVAO);
+    set_MeshAttributes();
+    glGenBuffers(1, &bondInstanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, bondInstanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
+    set_BondInstanceAttributes();
+
+    // impostor模式: 每根键一个四边形, 片段着色器与带端盖的圆柱求交
+    glGenVertexArrays(1, &bondImpostorVAO);
+    glBindVertexArray(bondImpostorVAO);
+    set_BondInstanceAttributes();
+
+    glBindVertexArray(0);
+}
 
-    int stride = object->getInterleavedStride();        // object的stride必须一致
-    glVertexAttribPointer(0, 3, GL_FLOAT, false, stride*sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, false, stride*sizeof(float), (void*)(sizeof(float)*3));
-    glEnableVertexAttribArray(1);
+void MolViewer::set_BondInstanceAttributes(){
+    // 作用于当前绑定的VAO, 数据来自bondInstanceVBO
+    glBindBuffer(GL_ARRAY_BUFFER, bondInstanceVBO);
+    GLsizei stride = sizeof(BondInstance);
+    glVertexAttribPointer(2, 4, GL_FLOAT, false, stride, (void*)offsetof(BondInstance, start));
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glVertexAttribPointer(3, 4, GL_FLOAT, false, stride, (void*)offsetof(BondInstance, end));
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+    glVertexAttribPointer(4, 3, GL_FLOAT, false, stride, (void*)offsetof(BondInstance, color));
+    glEnableVertexAttribArray(4);
+    glVertexAttribDivisor(4, 1);
+    glVertexAttribIPointer(5, 2, GL_UNSIGNED_INT, stride, (void*)offsetof(BondInstance, first));
+    glEnableVertexAttribArray(5);
+    glVertexAttribDivisor(5, 1);
+    glVertexAttribIPointer(6, 1, GL_UNSIGNED_INT, stride, (void*)offsetof(BondInstance, id));
+    glEnableVertexAttribArray(6);
+    glVertexAttribDivisor(6, 1);
 }
 
-void MolViewer::build_Keys(BondType bondtype, const glm::vec3 end_point, const glm::vec3 start_point, vector<Cylinder* >& cylinders){
-    glm::vec3 key_vector = end_point - start_point;
-    glm::vec3 up_vector = glm::vec3(0.0f, 1.0f, 0.0f);
-    glm::vec3 move_vector = glm::normalize(glm::cross(key_vector, up_vector));
-    move_vector *= 0.05;
-    if(bondtype == MiniRDKit::Bond::DOUBLE){
-        Cylinder* cylinder1 = new Cylinder(end_point+move_vector, start_point+move_vector, 0.025,0.025,16,1, RED);
-        Cylinder* cylinder2 = new Cylinder(end_point-move_vector, start_point-move_vector, 0.025,0.025,16,1, BLUE);
-        cylinders.push_back(cylinder1);
-        cylinders.push_back(cylinder2);
-    }else{
-        Cylinder* cylinder = new Cylinder(end_point, start_point, 0.05,0.05,16,1, WRITE);
-        cylinders.push_back(cylinder);
+void MolViewer::upload_BondInstances(){
+    glBindBuffer(GL_ARRAY_BUFFER, bondInstanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, bond_draw_instances.size()*sizeof(BondInstance), bond_draw_instances.data(), GL_DYNAMIC_DRAW);
+}
+
+void MolViewer::build_Positions(){
+    // 所有读原子坐标的着色器的Positions块都绑定到binding 6, 容量在第一次上传时分配
+    glGenBuffers(1, &positionBuffer);
+    GLint alignment = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if(alignment > 0)
+        position_alignment = alignment;
+    positions_dirty = true;
+}
+
+void MolViewer::upload_Positions(){
+    // 换到另一半写入: 只等待上一次读这一半的绘制, 映射时不与GPU整体同步
+    size_t atom_count = max<size_t>(atom_instances.size(), 1);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, positionBuffer);
+    if(atom_count > position_capacity){
+        for(GLsync& fence: position_fences){
+            if(fence)
+                glDeleteSync(fence);
+            fence = nullptr;
+        }
+        position_capacity = atom_count;
+        position_half_size = (atom_count*sizeof(AtomPosition) + position_alignment-1) / position_alignment * position_alignment;
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 2*position_half_size, nullptr, GL_STREAM_DRAW);
+    }
+
+    position_half ^= 1;
+    GLsync& fence = position_fences[position_half];
+    if(fence){
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1000000000));
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    GLintptr offset = position_half*position_half_size;
+    GLsizeiptr size = atom_count*sizeof(AtomPosition);
+    AtomPosition* mapped = (AtomPosition*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, offset, size,
+                                                           GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if(mapped != nullptr){
+        ThreadPool::instance().parallelFor(0, atom_instances.size(), 16384, [this, mapped](size_t first, size_t last){
+            for(size_t i = first; i < last; ++i){
+                mapped[i].position = atom_instances[i].center;
+                mapped[i].node = scene_graph.getAtomNode(i);
+            }
+        });
+        glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
     }
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 6, positionBuffer, offset, size);
+    positions_dirty = false;
+}
+
+void MolViewer::fence_Positions(){
+    // 本帧读当前这一半的命令都已提交, 下次写入这一半前等待它
+    GLsync& fence = position_fences[position_half];
+    if(fence)
+        glDeleteSync(fence);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 }
 
-void MolViewer::create_CoordinateSystem(){
-    float line[(21/5+1)*(21/5+1)*2*2*6];
+void MolViewer::build_NodeMatrices(){
+    // 着色器的NodeMatrices块绑定到binding 2, 至少保留一个单位矩阵, 没有分子时也是合法的缓冲
+    glGenBuffers(1, &nodeBuffer);
+    nodes_dirty = true;
+}
 
-    int line_no = 0;
-    for(int i=-10.0; i<11.0; i+=5){
-        for(int j=-10.0; j<11.0; j+=5){
-            line[line_no*6] = i;
-            line[line_no*6+1] = j;
-            line[line_no*6+2] = -10.0;
-            line[line_no*6+3] = i;
-            line[line_no*6+4] = j;
-            line[line_no*6+5] = 10.0;
-            line_no++;
+void MolViewer::upload_NodeMatrices(){
+    // 先自上而下传播改过的节点, 再只上传世界矩阵变了的下标范围
+    size_t first = 0, last = 0;
+    bool changed = scene_graph.update(changed_nodes, first, last);
+    size_t node_count = max<size_t>(scene_graph.size(), 1);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, nodeBuffer);
+    if(node_count > node_capacity){
+        node_capacity = node_count;
+        glBufferData(GL_SHADER_STORAGE_BUFFER, node_capacity*sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+        nodes_dirty = true;
+    }
+    if(nodes_dirty){
+        first = 0;
+        last = node_count;
+        changed = true;
+        nodes_dirty = false;
+    }
+    if(changed){
+        node_matrices.resize(last-first);
+        for(size_t i = first; i < last; ++i)
+            node_matrices[i-first] = i < scene_graph.size() ? scene_graph.getNode(i).world : glm::mat4(1.0f);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, first*sizeof(glm::mat4), node_matrices.size()*sizeof(glm::mat4), node_matrices.data());
+    }
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 2, nodeBuffer, 0, node_count*sizeof(glm::mat4));
+}
+
+void MolViewer::refit_Bounds(){
+    // 实例中存的是节点内的局部坐标, 包围盒按世界坐标重新拟合; 只有CPU剔除用到BVH
+    ThreadPool& pool = ThreadPool::instance();
+    refit_boxes.resize(atom_instances.size());
+    pool.parallelFor(0, atom_instances.size(), 8192, [this](size_t first, size_t last){
+        for(size_t i = first; i < last; ++i){
+            AtomInstance atom = atom_instances[i];
+            atom.center = scene_graph.toWorld(i, atom.center);
+            refit_boxes[i] = atom_Bounds(atom);
         }
-        for(int k=-10.0; k<11.0; k+=5){
-            line[line_no*6] = i;
-            line[line_no*6+1] = -10.0;
-            line[line_no*6+2] = k;
-            line[line_no*6+3] = i;
-            line[line_no*6+4] = 10.0;
-            line[line_no*6+5] = k;
-            line_no++;
+    });
+    atom_bvh.refit(refit_boxes);
+    refit_boxes.resize(bond_instances.size());
+    pool.parallelFor(0, bond_instances.size(), 8192, [this](size_t first, size_t last){
+        for(size_t i = first; i < last; ++i){
+            BondInstance bond = bond_instances[i];
+            bond.start = scene_graph.toWorld(bond.first, bond.start);
+            bond.end = scene_graph.toWorld(bond.second, bond.end);
+            refit_boxes[i] = bond_Bounds(bond);
         }
+    });
+    bond_bvh.refit(refit_boxes);
+    bounds_stale = false;
+}
+
+static float atom_Radius(const AtomInstance& atom)       { return atom.radius; }
+static float bond_Radius(const BondInstance& bond)       { return bond.radius; }
+
+void MolViewer::update_Visibility(const QMatrix4x4& view){
+    // 先用BVH剔除视锥外的原子和键, 再按投影半径给可见的分级; 只在相机或实例变化时重做
+    glm::vec3 eye(camera->position.x(), camera->position.y(), camera->position.z());
+    glm::vec3 front(camera->front.x(), camera->front.y(), camera->front.z());
+    bool view_changed = eye != lod_eye || front != lod_front || camera->zoom != lod_zoom || height() != lod_height;
+    if(!instances_dirty && !view_changed)
+        return;
+    lod_eye = eye;
+    lod_front = front;
+    lod_zoom = camera->zoom;
+    lod_height = height();
+
+    glm::mat4 view_projection;
+    memcpy(glm::value_ptr(view_projection), (projection*view).constData(), sizeof(view_projection));
+    Frustum frustum(view_projection);
+    if(bounds_stale)
+        refit_Bounds();
+    atom_visible.clear();
+    bond_visible.clear();
+    atom_bvh.cull(frustum, atom_visible);
+    bond_bvh.cull(frustum, bond_visible);
+
+    lod_selector.setView(eye, front, glm::radians(camera->zoom), height());
+    // LOD按世界坐标中的中心计算
+    auto atom_center = [this](const AtomInstance& atom){ return scene_graph.toWorld(atom.id, atom.center); };
+    auto bond_center = [this](const BondInstance& bond){
+        return 0.5f*(scene_graph.toWorld(bond.first, bond.start) + scene_graph.toWorld(bond.second, bond.end));
+    };
+    atom_buckets = bucket_ByLod(atom_instances, atom_visible, lod_selector, atom_center, atom_Radius, atom_draw_instances, atom_slots);
+    bond_buckets = bucket_ByLod(bond_instances, bond_visible, lod_selector, bond_center, bond_Radius, bond_draw_instances, bond_slots);
+
+    upload_AtomInstances();
+    upload_BondInstances();
+    update_DrawCommands();
+    instances_dirty = false;
+
+    emit drawStatsChanged(QString("atoms %1/%2  bonds %3/%4")
+                          .arg(atom_visible.size()).arg(atom_instances.size())
+                          .arg(bond_visible.size()).arg(bond_instances.size()));
+}
+
+void MolViewer::build_GpuCulling(){
+    glGenBuffers(1, &atomSourceBuffer);
+    glGenBuffers(1, &bondSourceBuffer);
+    glGenBuffers(1, &atomVisibleBuffer);
+    glGenBuffers(1, &bondVisibleBuffer);
+    glGenBuffers(1, &cullCommandBuffer);
+
+    // 网格来自合并缓冲, 唯一的实例属性是cull.cs写出的实例编号
+    glGenVertexArrays(1, &atomCulledVAO);
+    glBindVertexArray(atomCulledVAO);
+    set_MeshAttributes();
+    glBindBuffer(GL_ARRAY_BUFFER, atomVisibleBuffer);
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(unsigned int), (void*)0);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+
+    glGenVertexArrays(1, &bondCulledVAO);
+    glBindVertexArray(bondCulledVAO);
+    set_MeshAttributes();
+    glBindBuffer(GL_ARRAY_BUFFER, bondVisibleBuffer);
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(unsigned int), (void*)0);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+
+    glBindVertexArray(0);
+
+    glGenFramebuffers(1, &hizDepthFBO);
+}
+
+void MolViewer::upload_CullSources(){
+    // 实例按原始顺序上传, 坐标来自位置流, 播放轨迹时不必重传; 每个LOD级别在可见列表中占一段与实例总数等长的区间
+    unsigned int atom_count = atom_instances.size();
+    unsigned int bond_count = bond_instances.size();
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, atomSourceBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, atom_count*sizeof(AtomInstance), atom_instances.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, atomVisibleBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, LOD_LEVELS*atom_count*sizeof(unsigned int), nullptr, GL_DYNAMIC_COPY);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, bondSourceBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, bond_count*sizeof(BondInstance), bond_instances.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, bondVisibleBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, LOD_LEVELS*bond_count*sizeof(unsigned int), nullptr, GL_DYNAMIC_COPY);
+
+    // 原子命令在前, 键命令在后, 与CPU路径的draw_commands相同
+    cull_commands.clear();
+    for(int l = 0; l < LOD_LEVELS; ++l){
+        const MeshRange& mesh = sphereLods[l];
+        cull_commands.push_back({mesh.indexCount, 0, mesh.firstIndex, mesh.baseVertex, l*atom_count});
+    }
+    for(int l = 0; l < LOD_LEVELS; ++l){
+        const MeshRange& mesh = cylinderLods[l];
+        cull_commands.push_back({mesh.indexCount, 0, mesh.firstIndex, mesh.baseVertex, l*bond_count});
     }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, cullCommandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, cull_commands.size()*sizeof(DrawElementsIndirectCommand), cull_commands.data(), GL_DYNAMIC_DRAW);
+}
+
+void MolViewer::cull_OnGpu(const QMatrix4x4& view){
+    // 固定的两次dispatch完成视锥/遮挡剔除与LOD分组, CPU不再遍历实例
+    if(instances_dirty){
+        upload_CullSources();
+        instances_dirty = false;
+        hiz_valid = false;      // 上一帧的深度属于旧的分子
+        emit drawStatsChanged(QString("atoms %1  bonds %2  (GPU culling)").arg(atom_instances.size()).arg(bond_instances.size()));
+    }
+
+    // instanceCount清零
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, cullCommandBuffer);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, cull_commands.size()*sizeof(DrawElementsIndirectCommand), cull_commands.data());
+
+    memcpy(glm::value_ptr(cull_view_projection), (projection*view).constData(), sizeof(cull_view_projection));
+    Frustum frustum(cull_view_projection);
+    glm::vec3 eye(camera->position.x(), camera->position.y(), camera->position.z());
+    glm::vec3 front(camera->front.x(), camera->front.y(), camera->front.z());
+    lod_selector.setView(eye, front, glm::radians(camera->zoom), height());
+
+    cullShader.bind();
+    GLuint program = cullShader.programId();
+    glUniform4fv(glGetUniformLocation(program, "planes"), 6, glm::value_ptr(frustum.getPlanes()[0]));
+    glUniform3fv(glGetUniformLocation(program, "eye"), 1, glm::value_ptr(eye));
+    glUniform3fv(glGetUniformLocation(program, "forward"), 1, glm::value_ptr(glm::normalize(front)));
+    glUniform1f(glGetUniformLocation(program, "pixelScale"), lod_selector.getPixelScale());
+    glUniform1fv(glGetUniformLocation(program, "thresholds"), LOD_LEVELS-1, LOD_PIXEL_THRESHOLDS);
+    glUniform1i(glGetUniformLocation(program, "useHiZ"), hiz_valid);
+    glUniformMatrix4fv(glGetUniformLocation(program, "previousViewProjection"), 1, GL_FALSE, glm::value_ptr(hiz_view_projection));
+    glUniform1i(glGetUniformLocation(program, "hiZ"), 0);
+    glUniform1i(glGetUniformLocation(program, "hiZLevels"), hiz_levels);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, hizTexture);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, atomSourceBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, bondSourceBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, cullCommandBuffer);
+    GLint count_location = glGetUniformLocation(program, "instanceCount");
+    GLint first_location = glGetUniformLocation(program, "commandFirst");
+    GLint bonds_location = glGetUniformLocation(program, "cullBonds");
+
+    unsigned int atom_count = atom_instances.size();
+    if(atom_count > 0){
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, atomVisibleBuffer);
+        glUniform1ui(count_location, atom_count);
+        glUniform1ui(first_location, 0);
+        glUniform1i(bonds_location, 0);
+        glDispatchCompute((atom_count+63)/64, 1, 1);
+    }
+    unsigned int bond_count = bond_instances.size();
+    if(bond_count > 0){
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, bondVisibleBuffer);
+        glUniform1ui(count_location, bond_count);
+        glUniform1ui(first_location, LOD_LEVELS);
+        glUniform1i(bonds_location, 1);
+        glDispatchCompute((bond_count+63)/64, 1, 1);
+    }
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void MolViewer::update_HiZ(){
+    // 把本帧深度复制出来并逐级取最大值, 供下一帧的遮挡剔除使用
+    int w = width()*devicePixelRatio();
+    int h = height()*devicePixelRatio();
+    if(w != hiz_width || h != hiz_height){
+        hiz_width = w;
+        hiz_height = h;
+        hiz_levels = 1;
+        while((max(w, h) >> hiz_levels) > 0)
+            ++hiz_levels;
+        hiz_valid = false;
+
+        // 格式与QOpenGLWidget的深度/模板附件一致, 才能直接blit
+        glDeleteTextures(1, &hizDepthTexture);
+        glGenTextures(1, &hizDepthTexture);
+        glBindTexture(GL_TEXTURE_2D, hizDepthTexture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH24_STENCIL8, w, h);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, hizDepthFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, hizDepthTexture, 0);
+
+        glDeleteTextures(1, &hizTexture);
+        glGenTextures(1, &hizTexture);
+        glBindTexture(GL_TEXTURE_2D, hizTexture);
+        glTexStorage2D(GL_TEXTURE_2D, hiz_levels, GL_R32F, w, h);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, defaultFramebufferObject());
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, hizDepthFBO);
+    glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+
+    hizShader.bind();
+    GLuint program = hizShader.programId();
+    glUniform1i(glGetUniformLocation(program, "source"), 0);
+    glActiveTexture(GL_TEXTURE0);
+    for(int level = 0; level < hiz_levels; ++level){
+        int level_w = max(w >> level, 1);
+        int level_h = max(h >> level, 1);
+        glBindTexture(GL_TEXTURE_2D, level == 0 ? hizDepthTexture : hizTexture);
+        glUniform1i(glGetUniformLocation(program, "copyDepth"), level == 0);
+        glUniform1i(glGetUniformLocation(program, "sourceLevel"), level-1);
+        glBindImageTexture(0, hizTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((level_w+7)/8, (level_h+7)/8, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+
+    // 相机或原子移动后, 本帧是用旧的深度剔除的, 可能漏画刚露出的物体; 再画一帧即可收敛
+    bool view_moved = hiz_view_projection != cull_view_projection || hiz_stale;
+    hiz_view_projection = cull_view_projection;
+    hiz_valid = true;
+    hiz_stale = false;
+    if(view_moved)
+        update();
+}
 
-    for(int k=-10.0; k<11.0; k+=5){
-        for(int i=-10.0; i<11.0; i+=5){
-            line[line_no*6] = i;
-            line[line_no*6+1] = -10.0;
-            line[line_no*6+2] = k;
-            line[line_no*6+3] = i;
-            line[line_no*6+4] = 10.0;
-            line[line_no*6+5] = k;
-            line_no++;
+void MolViewer::build_IdBuffer(){
+    // 附件的大小在第一次拾取时按窗口分配
+    glGenFramebuffers(1, &idFBO);
+    glGenRenderbuffers(1, &idDepthBuffer);
+    glGenBuffers(1, &idPBO);
+}
+
+void MolViewer::draw_IdBuffer(){
+    // 用上一帧的剔除结果和FrameUniforms重画一遍原子和键, 每个像素写入编号
+    int w = width()*devicePixelRatio();
+    int h = height()*devicePixelRatio();
+    if(w != id_width || h != id_height){
+        id_width = w;
+        id_height = h;
+        glDeleteTextures(1, &idTexture);
+        glGenTextures(1, &idTexture);
+        glBindTexture(GL_TEXTURE_2D, idTexture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32UI, w, h);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindRenderbuffer(GL_RENDERBUFFER, idDepthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, w, h);
+        glBindFramebuffer(GL_FRAMEBUFFER, idFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, idTexture, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, idDepthBuffer);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, idFBO);
+    glViewport(0, 0, w, h);
+    const GLuint background[4] = {0, 0, 0, 0};
+    glClearBufferuiv(GL_COLOR, 0, background);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    draw_Molecule(true);
+    fence_Positions();          // 同样读了位置流的当前一半
+    glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+    id_stale = false;
+}
+
+void MolViewer::build_Selection(){
+    // 所有原子着色器的Selection块都绑定到binding 5
+    glGenBuffers(1, &selectionBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, selectionBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(unsigned int), nullptr, GL_DYNAMIC_DRAW);
+    selection_words = 1;
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, selectionBuffer);
+}
+
+void MolViewer::upload_Selection(){
+    // 只上传自上次以来变化的字; 原子数变化时重新分配
+    size_t first, last;
+    if(!selection.takeDirty(first, last))
+        return;
+    const vector<unsigned int>& words = selection.getWords();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, selectionBuffer);
+    if(max<size_t>(words.size(), 1) != selection_words){
+        selection_words = max<size_t>(words.size(), 1);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, selection_words*sizeof(unsigned int), nullptr, GL_DYNAMIC_DRAW);
+        first = 0;
+        last = words.size();
+    }
+    if(last > first)
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, first*sizeof(unsigned int), (last-first)*sizeof(unsigned int), &words[first]);
+}
+
+void MolViewer::build_FrameUniforms(){
+    // 所有着色器的FrameUniforms块都绑定到binding 0
+    glGenBuffers(1, &frameUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, frameUBO);
+}
+
+void MolViewer::update_FrameUniforms(const QMatrix4x4& view){
+    // 每帧只上传一次, 与物体数量无关
+    FrameUniforms frame;
+    memcpy(glm::value_ptr(frame.view), view.constData(), sizeof(frame.view));
+    memcpy(glm::value_ptr(frame.projection), projection.constData(), sizeof(frame.projection));
+    frame.lightPos = glm::vec4(lightPos.x(), lightPos.y(), lightPos.z(), 1.0f);
+    frame.lightColor = glm::vec4(lightColor.x(), lightColor.y(), lightColor.z(), 1.0f);
+    frame.viewPos = glm::vec4(camera->position.x(), camera->position.y(), camera->position.z(), 1.0f);
+
+    glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
+}
+
+void MolViewer::create_CoordinateSystem(glm::vec3 lower, glm::vec3 upper){
+    // 网格范围对齐到步长, 范围不变时直接复用已上传的VAO
+    const float step = 5.0f;
+    glm::vec3 grid_lower = glm::floor(lower/step)*step;
+    glm::vec3 grid_upper = glm::ceil(upper/step)*step;
+    if(coordinateVAO != 0 && grid_lower == coordinate_lower && grid_upper == coordinate_upper)
+        return;
+    coordinate_lower = grid_lower;
+    coordinate_upper = grid_upper;
+
+    int nx = int((grid_upper.x-grid_lower.x)/step)+1;
+    int ny = int((grid_upper.y-grid_lower.y)/step)+1;
+    int nz = int((grid_upper.z-grid_lower.z)/step)+1;
+
+    // 每个顶点: 位置 + 颜色
+    const glm::vec3 color = WHITE;
+    vector<float> line;
+    line.reserve((nx*ny + nx*nz + ny*nz)*12);
+    auto add_line = [&line, &color](glm::vec3 a, glm::vec3 b){
+        line.insert(line.end(), {a.x, a.y, a.z, color.r, color.g, color.b,
+                                 b.x, b.y, b.z, color.r, color.g, color.b});
+    };
+    for(int i=0; i<nx; ++i){
+        float x = grid_lower.x + i*step;
+        for(int j=0; j<ny; ++j){        // 平行于z轴
+            float y = grid_lower.y + j*step;
+            add_line(glm::vec3(x, y, grid_lower.z), glm::vec3(x, y, grid_upper.z));
         }
-        for(int j=-10.0; j<11.0; j+=5){
-            line[line_no*6] = -10.0;
-            line[line_no*6+1] = j;
-            line[line_no*6+2] = k;
-            line[line_no*6+3] = 10.0;
-            line[line_no*6+4] = j;
-            line[line_no*6+5] = k;
-            line_no++;
+        for(int k=0; k<nz; ++k){        // 平行于y轴
+            float z = grid_lower.z + k*step;
+            add_line(glm::vec3(x, grid_lower.y, z), glm::vec3(x, grid_upper.y, z));
+        }
+    }
+    for(int j=0; j<ny; ++j){            // 平行于x轴
+        float y = grid_lower.y + j*step;
+        for(int k=0; k<nz; ++k){
+            float z = grid_lower.z + k*step;
+            add_line(glm::vec3(grid_lower.x, y, z), glm::vec3(grid_upper.x, y, z));
         }
     }
 
-    unsigned int coordinateVAO, coordinateVBO;
-    glGenVertexArrays(1, &coordinateVAO);
-    glGenBuffers(1, &coordinateVBO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, coordinateVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(line), line, GL_STATIC_DRAW);
+    if(coordinateVAO == 0){
+        glGenVertexArrays(1, &coordinateVAO);
+        glGenBuffers(1, &coordinateVBO);
+    }
     glBindVertexArray(coordinateVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, coordinateVBO);
+    glBufferData(GL_ARRAY_BUFFER, line.size()*sizeof(float), line.data(), GL_STATIC_DRAW);
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, false, 3*sizeof(float), (void*)0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, false, 6*sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
+    glVertexAttribPointer(2, 3, GL_FLOAT, false, 6*sizeof(float), (void*)(sizeof(float)*3));
+    glEnableVertexAttribArray(2);
+    glBindVertexArray(0);
 
-    molShader.setUniformValue("objectColor", glm2Qvector(WHITE));
+    coordinate_vertexcount = line.size()/6;
+}
+
+void MolViewer::draw_CoordinateSystem(){
+    glBindVertexArray(coordinateVAO);
     glLineWidth(1.0);
-    glDrawArrays(GL_LINES, 0, sizeof(line)/sizeof(float));
+    glDrawArrays(GL_LINES, 0, coordinate_vertexcount);
 }
@@ -3,9 +3,10 @@
 
 #include <QOpenGLWidget>
 #include <QOpenGLExtraFunctions>
-#include <QOpenGLFunctions_4_2_Core>
+#include <QOpenGLFunctions_4_3_Core>
 #include <QOpenGLShaderProgram>
 #include <QFileDialog>
+#include <QRubberBand>
 #include <QString>
 #include <QtMath>
 
@@ -23,24 +24,90 @@
 #include "sphere.h"
 #include "cylinder.h"
 #include "color_table.h"
+#include "instances.h"
+#include "scenebuffer.h"
+#include "lod.h"
+#include "meshcache.h"
+#include "bvh.h"
+#include "scenegraph.h"
+#include "selection.h"
+#include "molloader.h"
+#include "trajectory.h"
 
 using namespace std;
 
-class MolViewer: public QOpenGLWidget, protected QOpenGLFunctions_4_2_Core{
-    Q_OBJECT
+// 原子/键的绘制方式: 三角网格或光线求交的impostor
+enum RenderMode{
+    MESH_MODE,
+    IMPOSTOR_MODE
+};
+
+// 剔除和LOD分组在CPU(BVH)还是GPU(计算着色器)上进行
+enum CullMode{
+    CPU_CULLING,
+    GPU_CULLING
+};
 
-    typedef MiniRDKit::Bond::BondType BondType;
+// 拾取请求: 悬停和点击读回光标下的一个像素, 框选读回整个矩形
+enum PickMode{
+    PICK_NONE,
+    PICK_HOVER,
+    PICK_CLICK,
+    PICK_RECTANGLE
+};
+
+// 每帧常量, std140布局, 与frame.glsl中的FrameUniforms块一致
+struct FrameUniforms{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec4 lightPos;
+    glm::vec4 lightColor;
+    glm::vec4 viewPos;
+};
+
+class MolViewer: public QOpenGLWidget, protected QOpenGLFunctions_4_3_Core{
+    Q_OBJECT
 
     public:
         explicit MolViewer(QWidget *parent = nullptr, string molfile = "");
         ~MolViewer() Q_DECL_OVERRIDE;
 
         void setMolFilePath(string mol_file_path);
+        MolLoader* getLoader() const    { return loader; }
+
+        void setRenderMode(RenderMode mode);
+
+        void setCullMode(CullMode mode);
+
+        // 轨迹播放: 只有原子坐标逐帧变化, 实例和网格保持不动
+        int getFrameCount() const       { return trajectory ? int(trajectory->getFrameCount()) : 1; }
+        int getCurrentFrame() const     { return current_frame; }
+        void setFrame(int frame);
+        void setTrajectory(shared_ptr<Trajectory> frames);     // 原子数与当前结构不符时忽略
+        size_t getAtomCount() const     { return atom_instances.size(); }
+
+        // 场景图: 分子/链/残基节点, 移动节点只改它的矩阵, 原子坐标和实例不动
+        // Ctrl+拖动平移光标下的残基(配体), Ctrl+Shift+拖动平移整条链
+        void setNodeTransform(unsigned int node, const glm::mat4& local);
+        void play();
+        void pause();
+        bool isPlaying() const;
 
         QVector3D glm2Qvector(glm::vec3 vec);
 
         QMatrix4x4 glm2QMatrix(glm::mat4 matrix);
 
+    signals:
+        void drawStatsChanged(const QString& message);     // 剔除后实际绘制的原子/键数
+        void trajectoryChanged(int frame_count);            // 换入新场景后的帧数, 静态结构为1
+        void frameChanged(int frame);
+        void hoverChanged(const QString& label);          // 鼠标下的原子/键, 移开时为空
+
+    private slots:
+        void receive_Scene(QSharedPointer<MolScene> scene);
+        void next_Frame();
+        void finish_Pick();
+
     protected:
         void initializeGL()  Q_DECL_OVERRIDE;
         void resizeGL(int w, int h) Q_DECL_OVERRIDE;
@@ -55,40 +122,229 @@ class MolViewer: public QOpenGLWidget, protected QOpenGLFunctions_4_2_Core{
 
         void wheelEvent(QWheelEvent *event) Q_DECL_OVERRIDE;
 
-        QVector4D ScreenCoordinate2_WorldCoordinate(int xpos, int ypos);
-        void ray_cating(int xpos, int ypos);
-        void create_CoordinateSystem();     // 绘制坐标系
+        void request_Pick(PickMode mode, const QRect& rect);     // rect为窗口坐标
+        void issue_Pick(PickMode mode, const QRect& pixels);
+        bool collect_Pick();
+        void apply_Pick(PickMode mode, const unsigned int* ids, size_t count);
+        void cancel_Pick();
+        Ray screen_Ray(int xpos, int ypos);
+        void ray_Pick(int xpos, int ypos, int& atom, int& bond);
+        void show_Hover(int atom, int bond);
+        glm::vec3 drag_Point(int xpos, int ypos);
+        QString atom_Label(unsigned int atom) const;
+        void create_CoordinateSystem(glm::vec3 lower, glm::vec3 upper);     // 按分子包围盒构建坐标网格
+        void draw_CoordinateSystem();       // 绘制坐标系
 
     private:
-        bool createShader();
+        bool createShader(QOpenGLShaderProgram& shader, const QString& vertexPath, const QString& fragmentPath);
+        bool createComputeShader(QOpenGLShaderProgram& shader, const QString& computePath);
         void clear_all();
+        void apply_Scene();
         uint loadTexture(const QString& path);
-        void build_GLobject(GraphicObject* object, int& total_vertexcount, int& total_indexcount);
-        void build_Keys(BondType bondtype, const glm::vec3 end_point, const glm::vec3 start_point, vector<Cylinder* >& cylinders);
+        MeshRange build_GLobject(const shared_ptr<const GraphicObject>& mesh);
+        void upload_SceneBuffer();
+        GLenum mesh_IndexType() const;
+        void set_MeshAttributes();
+        void update_DrawCommands();
+        void build_AtomInstances();
+        void set_AtomInstanceAttributes();
+        void upload_AtomInstances();
+        void build_BondInstances();
+        void set_BondInstanceAttributes();
+        void upload_BondInstances();
+        void build_Positions();
+        void upload_Positions();
+        void fence_Positions();
+        void build_NodeMatrices();
+        void upload_NodeMatrices();
+        void refit_Bounds();
+        void draw_Molecule(bool pick_ids);
+        void build_IdBuffer();
+        void draw_IdBuffer();
+        void update_Visibility(const QMatrix4x4& view);
+        bool use_GpuCulling() const     { return cull_mode == GPU_CULLING && render_mode == MESH_MODE; }
+        void build_GpuCulling();
+        void upload_CullSources();
+        void cull_OnGpu(const QMatrix4x4& view);
+        void update_HiZ();
+        void build_Selection();
+        void upload_Selection();
+        void build_FrameUniforms();
+        void update_FrameUniforms(const QMatrix4x4& view);
 
     private:
+        bool gl_ready = false;                      // 取得4.3核心函数后为true, 否则所有GL路径都跳过
+
         QOpenGLShaderProgram molShader;
+        QOpenGLShaderProgram atomShader;
+        QOpenGLShaderProgram bondShader;
+        QOpenGLShaderProgram atomImpostorShader;
+        QOpenGLShaderProgram bondImpostorShader;
+        QOpenGLShaderProgram atomCulledShader;
+        QOpenGLShaderProgram bondCulledShader;
+        QOpenGLShaderProgram atomIdShader;
+        QOpenGLShaderProgram bondIdShader;
+        QOpenGLShaderProgram atomImpostorIdShader;
+        QOpenGLShaderProgram bondImpostorIdShader;
+        QOpenGLShaderProgram atomCulledIdShader;
+        QOpenGLShaderProgram bondCulledIdShader;
+        QOpenGLShaderProgram cullShader;
+        QOpenGLShaderProgram hizShader;
+
+        RenderMode render_mode = MESH_MODE;
+        CullMode cull_mode = CPU_CULLING;
+
+        uint frameUBO = 0;
         string MolFilePath;
         string recentFile = "";
         QFileDialog* fileOperator;
         MiniRDKit::RWMol* mol = nullptr;
+        AtomTable atom_table;                       // 原子/键的列数据, 实例由它生成
+        BondTable bond_table;
+        MolLoader* loader = nullptr;
+        QSharedPointer<MolScene> pending_scene;     // 已载入完成, 等待下一帧换入
 
         QTimer* m_pTimer = nullptr;
         int     m_nTimeValue = 0;
         qint64 last_LeftButton_click_time;
         bool firstMouse = true;
         bool all_selected = false;
+        int hovered_atom = -1;
+        int hovered_bond = -1;
+
+        // 选中状态只存在位集中, 着色器按原子id查询
+        SelectionSet selection;
+        uint selectionBuffer = 0;
+        size_t selection_words = 0;
 
         uint VAO, VBO, EBO;
         uint diffuseMap, specularMap;
 
-        vector<unsigned int> vaos;
-        vector<unsigned int> vbos;
+        // 所有网格合并在一个VBO/EBO中, 通过间接绘制命令提交
+        SceneBuffer scene_buffer = SceneBuffer(VERTEX_PACKED);
+        uint sceneVBO = 0;
+        uint sceneEBO = 0;
+        uint indirectBuffer = 0;
+        vector<DrawElementsIndirectCommand> draw_commands;
+        int atom_command_first = 0;
+        int atom_command_count = 0;
+        int bond_command_first = 0;
+        int bond_command_count = 0;
+
+        // 实例化绘制的原子: 共享一个单位球网格, 每个原子只有一条实例数据
+        MeshRange sphereLods[LOD_LEVELS];
+        uint atomVAO = 0;
+        uint atomInstanceVBO = 0;
+        uint atomImpostorVAO = 0;
+        vector<AtomInstance> atom_instances;
+        vector<AtomInstance> atom_draw_instances;   // 按LOD分组后实际上传的顺序
+        vector<unsigned int> atom_slots;            // atom_instances[i]在atom_draw_instances中的位置
+        LodBuckets atom_buckets = LodBuckets();
+
+        // 实例化绘制的键: 共享一个单位圆柱网格
+        MeshRange cylinderLods[LOD_LEVELS];
+        uint bondVAO = 0;
+        uint bondInstanceVBO = 0;
+        uint bondImpostorVAO = 0;
+        vector<BondInstance> bond_instances;
+        vector<BondInstance> bond_draw_instances;
+        vector<unsigned int> bond_slots;
+        LodBuckets bond_buckets = LodBuckets();
+
+        // 原子/键的包围盒层次, 载入时构建, 每帧按视锥剔除; 播放轨迹时只重新拟合包围盒
+        Bvh atom_bvh;
+        Bvh bond_bvh;
+        vector<BoundingBox> refit_boxes;
+        bool bounds_stale = false;                  // 换帧或移动节点后, 下次CPU剔除前按世界坐标重新拟合
+        vector<unsigned int> atom_visible;
+        vector<unsigned int> bond_visible;
+
+        // 上一次剔除和LOD分组时的相机状态
+        LodSelector lod_selector;
+        bool instances_dirty = true;
+        glm::vec3 lod_eye;
+        glm::vec3 lod_front;
+        float lod_zoom = 0.0f;
+        int lod_height = 0;
 
-        int total_vertexcount = 0;
-        int total_indexcount = 0;
+        // 位置流: 每个原子一个AtomPosition(节点内的局部坐标和节点下标), 所有原子/键着色器和cull.cs都从这里取坐标(binding 6)
+        // 缓冲分成两半交替写入, 每一半用栅栏记录最后一次读取它的绘制, 写入前等待而不是整体同步
+        uint positionBuffer = 0;
+        size_t position_capacity = 0;               // 每一半能容纳的原子数
+        size_t position_half_size = 0;              // 每一半的字节数, 按SSBO偏移对齐
+        size_t position_alignment = 256;
+        int position_half = 0;                      // 当前绑定的一半
+        GLsync position_fences[2] = {nullptr, nullptr};
+        bool positions_dirty = true;
 
-        vector<GraphicObject* > objects;
+        // 场景图节点的世界矩阵(binding 2), 每帧只上传世界矩阵变了的那一段
+        SceneGraph scene_graph;
+        uint nodeBuffer = 0;
+        size_t node_capacity = 0;
+        vector<unsigned char> changed_nodes;
+        vector<glm::mat4> node_matrices;
+        bool nodes_dirty = true;                    // 换了场景, 整个缓冲重新上传
+
+        // 轨迹播放
+        shared_ptr<Trajectory> trajectory;
+        vector<float> frame_positions;
+        int current_frame = 0;
+        QTimer* play_timer = nullptr;
+
+        // GPU剔除: 实例按原始顺序放在SSBO中, 计算着色器把可见实例的编号按LOD写入各自的区间
+        // 并用atomicAdd累加间接绘制命令的instanceCount; 包围盒由位置流现算
+        uint atomSourceBuffer = 0;
+        uint bondSourceBuffer = 0;
+        uint atomVisibleBuffer = 0;
+        uint bondVisibleBuffer = 0;
+        uint cullCommandBuffer = 0;
+        uint atomCulledVAO = 0;
+        uint bondCulledVAO = 0;
+        vector<DrawElementsIndirectCommand> cull_commands;     // instanceCount为0的模板, 每帧重新上传
+        glm::mat4 cull_view_projection;
+
+        // ID缓冲: 按需离屏重画屏幕上的原子/键编号(R32UI), 拾取只读回光标下的像素或框选的矩形
+        // 读回写入PBO, 栅栏到达后再映射, GUI线程不等待GPU; 代价与场景大小无关
+        uint idFBO = 0;
+        uint idTexture = 0;
+        uint idDepthBuffer = 0;
+        uint idPBO = 0;
+        size_t id_pbo_size = 0;
+        int id_width = 0;
+        int id_height = 0;
+        bool id_stale = true;                       // 相机/实例/坐标/节点变换变过, 拾取前要重画ID缓冲
+        QMatrix4x4 id_view_projection;              // 上一次判断id_stale时的相机
+        GLsync id_fence = nullptr;
+        PickMode issued_pick = PICK_NONE;           // 正在读回的请求
+        QRect issued_pixels;                        // ID缓冲中的像素, 原点在左下
+        PickMode pending_pick = PICK_NONE;          // 等待发出的请求, 悬停只保留最新的一个
+        QRect pending_pixels;
+        QTimer* pick_timer = nullptr;               // 有读回在途时每16ms查看一次栅栏
+        QRubberBand* rubber_band = nullptr;         // Shift+拖动框选
+        QPoint rubber_origin;
+
+        // Ctrl+拖动节点: 光标在过被拾取原子且垂直视线的平面上移动多少, 节点就在世界空间平移多少
+        int drag_node = -1;
+        glm::mat4 drag_local;                       // 按下时节点的局部矩阵
+        glm::vec3 drag_anchor;                      // 按下时被拾取原子的世界坐标
+
+        // 上一帧深度的层次最大值(Hi-Z), 用于遮挡剔除
+        uint hizDepthFBO = 0;
+        uint hizDepthTexture = 0;
+        uint hizTexture = 0;
+        int hiz_width = 0;
+        int hiz_height = 0;
+        int hiz_levels = 0;
+        bool hiz_valid = false;
+        bool hiz_stale = false;                     // 原子移动过, 即使相机不动也要再画一帧
+        glm::mat4 hiz_view_projection;
+
+        // 坐标网格只在范围变化时重建
+        uint coordinateVAO = 0;
+        uint coordinateVBO = 0;
+        int coordinate_vertexcount = 0;
+        glm::vec3 coordinate_lower;
+        glm::vec3 coordinate_upper;
 
         float camera_oginin_x = 10.0f;
         float camera_oginin_y = 0.0f;
@@ -105,12 +361,9 @@ class MolViewer: public QOpenGLWidget, protected QOpenGLFunctions_4_2_Core{
 
         QMatrix4x4 projection;
         QMatrix4x4 global_projection;
-        QMatrix4x4 model;
 
         QVector3D lightColor = QVector3D(1.0f, 1.0f, 1.0f);
 
-        map<int, bool> aromatic_map;
-
         template<class T, class... Args>
         std::unique_ptr<T> make_unique(Args&&... args){
             return std::unique_ptr<T>(new T(std::forward<Args>(args)...));
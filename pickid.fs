@@ -0,0 +1,11 @@
+#version 420 core
+// ID buffer for picking (GL_R32UI): 0 is the background, atoms store id + 1,
+// bonds store their index in bond_instances + 1 with the top bit set
+layout (location = 0) out uint FragId;
+
+flat in uint PickId;
+
+void main()
+{
+    FragId = PickId;
+}
@@ -0,0 +1,162 @@
+#include "scenebuffer.h"
+
+#include <cmath>
+#include <cstring>
+
+// 16位索引能寻址的顶点数
+const unsigned int SHORT_INDEX_VERTICES = 65536;
+
+// float转半精度, 就近舍入; 单位网格的坐标不会溢出, 但仍按规则处理无穷和非规格化数
+static unsigned short float_To_Half(float value){
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+    unsigned int sign = (bits >> 16) & 0x8000u;
+    int exponent = int((bits >> 23) & 0xFFu) - 127 + 15;
+    unsigned int mantissa = bits & 0x7FFFFFu;
+
+    if(exponent >= 31){
+        bool nan = ((bits >> 23) & 0xFFu) == 0xFFu && mantissa != 0;
+        return (unsigned short)(sign | 0x7C00u | (nan ? 0x200u : 0u));
+    }
+    if(exponent <= 0){
+        if(exponent < -10)
+            return (unsigned short)sign;
+        mantissa |= 0x800000u;
+        unsigned int shift = (unsigned int)(14 - exponent);
+        unsigned int half = mantissa >> shift;
+        unsigned int rest = mantissa & ((1u << shift) - 1);
+        unsigned int halfway = 1u << (shift - 1);
+        if(rest > halfway || (rest == halfway && (half & 1u)))
+            ++half;
+        return (unsigned short)(sign | half);
+    }
+    unsigned int half = ((unsigned int)exponent << 10) | (mantissa >> 13);
+    unsigned int rest = mantissa & 0x1FFFu;
+    if(rest > 0x1000u || (rest == 0x1000u && (half & 1u)))
+        ++half;                                 // 进位到指数时结果依然正确
+    return (unsigned short)(sign | half);
+}
+
+static short to_Snorm16(float value){
+    value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+    return (short)lround(value * 32767.0f);
+}
+
+// 单位法向投影到八面体再展开到[-1,1]^2, 下半球沿对角线折到外侧; 解码见顶点着色器的decodeNormal
+static void encode_Octahedral(float x, float y, float z, short* encoded){
+    float sum = fabs(x) + fabs(y) + fabs(z);
+    if(sum == 0.0f){
+        encoded[0] = encoded[1] = 0;
+        return;
+    }
+    float u = x / sum;
+    float v = y / sum;
+    if(z < 0.0f){
+        float folded_u = (1.0f - fabs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+        float folded_v = (1.0f - fabs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+        u = folded_u;
+        v = folded_v;
+    }
+    encoded[0] = to_Snorm16(u);
+    encoded[1] = to_Snorm16(v);
+}
+
+MeshRange SceneBuffer::add(const GraphicObject* object){
+    MeshRange range;
+    range.baseVertex = format == VERTEX_PACKED ? (unsigned int)packed_vertices.size() : (unsigned int)(vertices.size() / stride);
+    range.firstIndex = (unsigned int)(indices.size() + short_indices.size());
+    range.indexCount = object->getIndexCount();
+
+    if(format == VERTEX_PACKED){
+        append_Packed(object);
+    }else{
+        const float* v = object->getInterleavedVertices();
+        vertices.insert(vertices.end(), v, v + object->getInterleavedVertexCount() * stride);
+    }
+
+    // 出现放不进16位索引的网格时, 已有的索引整体换成32位
+    if(hasShortIndices() && object->getInterleavedVertexCount() > SHORT_INDEX_VERTICES){
+        indices.assign(short_indices.begin(), short_indices.end());
+        vector<unsigned short>().swap(short_indices);
+        short_indices_fit = false;
+    }
+    const unsigned int* index = object->getIndices();
+    if(hasShortIndices())
+        short_indices.insert(short_indices.end(), index, index + range.indexCount);
+    else
+        indices.insert(indices.end(), index, index + range.indexCount);
+    return range;
+}
+
+MeshRange SceneBuffer::add(const shared_ptr<const GraphicObject>& mesh){
+    auto found = shared_ranges.find(mesh.get());
+    if(found != shared_ranges.end())
+        return found->second;
+    MeshRange range = add(mesh.get());
+    shared_ranges[mesh.get()] = range;
+    shared_meshes.push_back(mesh);
+    return range;
+}
+
+void SceneBuffer::append_Packed(const GraphicObject* object){
+    // 交错顶点的前6个float是位置和法向, 纹理坐标没有着色器读取, 直接丢掉
+    const float* v = object->getInterleavedVertices();
+    unsigned int count = object->getInterleavedVertexCount();
+    size_t first = packed_vertices.size();
+    packed_vertices.resize(first + count);
+    for(unsigned int i = 0; i < count; ++i, v += stride){
+        PackedVertex& packed = packed_vertices[first + i];
+        packed.position[0] = float_To_Half(v[0]);
+        packed.position[1] = float_To_Half(v[1]);
+        packed.position[2] = float_To_Half(v[2]);
+        packed.position[3] = float_To_Half(1.0f);
+        encode_Octahedral(v[3], v[4], v[5], packed.normal);
+    }
+}
+
+void SceneBuffer::releaseArrays(){
+    vector<float>().swap(vertices);
+    vector<PackedVertex>().swap(packed_vertices);
+    vector<unsigned int>().swap(indices);
+    vector<unsigned short>().swap(short_indices);
+}
+
+void SceneBuffer::clear(){
+    vector<float>().swap(vertices);
+    vector<PackedVertex>().swap(packed_vertices);
+    vector<unsigned int>().swap(indices);
+    vector<unsigned short>().swap(short_indices);
+    short_indices_fit = true;
+    shared_ranges.clear();
+    shared_meshes.clear();
+}
+
+const void* SceneBuffer::getVertices() const{
+    if(format == VERTEX_PACKED)
+        return packed_vertices.data();
+    return vertices.data();
+}
+
+unsigned int SceneBuffer::getVertexSize() const{
+    if(format == VERTEX_PACKED)
+        return (unsigned int)(packed_vertices.size() * sizeof(PackedVertex));
+    return (unsigned int)(vertices.size() * sizeof(float));
+}
+
+int SceneBuffer::getVertexStride() const{
+    if(format == VERTEX_PACKED)
+        return (int)sizeof(PackedVertex);
+    return stride * (int)sizeof(float);
+}
+
+const void* SceneBuffer::getIndices() const{
+    if(hasShortIndices())
+        return short_indices.data();
+    return indices.data();
+}
+
+unsigned int SceneBuffer::getIndexSize() const{
+    if(hasShortIndices())
+        return (unsigned int)(short_indices.size() * sizeof(unsigned short));
+    return (unsigned int)(indices.size() * sizeof(unsigned int));
+}
@@ -0,0 +1,79 @@
+#ifndef SCENEBUFFER_H
+#define SCENEBUFFER_H
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "GraphicObject.h"
+
+using namespace std;
+
+// 一个网格在合并缓冲中的位置
+struct MeshRange{
+    unsigned int baseVertex = 0;
+    unsigned int firstIndex = 0;
+    unsigned int indexCount = 0;
+};
+
+// 合并缓冲的顶点格式
+// VERTEX_FLOAT: GraphicObject的交错顶点原样拷贝(位置/法向/纹理坐标, 32 bytes), 32位索引
+// VERTEX_PACKED: 半精度位置 + 八面体编码的法向, 不带纹理坐标(12 bytes); 每个网格的顶点数都不超过65536时用16位索引
+enum VertexFormat{
+    VERTEX_FLOAT,
+    VERTEX_PACKED
+};
+
+// VERTEX_PACKED的一个顶点, 位置是单位网格内的坐标, position[3]只为让法向4字节对齐
+struct PackedVertex{
+    unsigned short position[4];                 // 半精度xyz, w为1
+    short normal[2];                            // 八面体编码, 按snorm16归一化
+};
+
+// glMultiDrawElementsIndirect使用的命令格式
+struct DrawElementsIndirectCommand{
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int firstIndex;
+    unsigned int baseVertex;
+    unsigned int baseInstance;
+};
+
+// 把所有GraphicObject的交错顶点和索引拼接到一个VBO/EBO中,
+// 每个网格通过baseVertex/firstIndex区分, 索引保持相对于自身顶点
+class SceneBuffer{
+public:
+    explicit SceneBuffer(VertexFormat format = VERTEX_FLOAT): format(format) {}
+
+    MeshRange add(const GraphicObject* object);
+    // 共享的网格(见MeshCache)只追加一次, 再次加入时返回同一区间; 句柄保留到clear()
+    MeshRange add(const shared_ptr<const GraphicObject>& mesh);
+    // 上传后释放暂存的顶点和索引, 格式和索引宽度不变; 之后要再add须先clear()
+    void releaseArrays();
+    void clear();
+
+    const vector<shared_ptr<const GraphicObject>>& getMeshes() const    { return shared_meshes; }
+
+    VertexFormat getFormat() const              { return format; }
+    const void* getVertices() const;
+    unsigned int getVertexSize() const;         // 字节数
+    int getVertexStride() const;                // 字节数
+    const void* getIndices() const;
+    unsigned int getIndexSize() const;          // 字节数
+    bool hasShortIndices() const                { return short_indices_fit && format == VERTEX_PACKED; }
+
+private:
+    void append_Packed(const GraphicObject* object);
+
+    VertexFormat format;
+    vector<float> vertices;
+    vector<PackedVertex> packed_vertices;
+    vector<unsigned int> indices;
+    vector<unsigned short> short_indices;
+    bool short_indices_fit = true;              // 目前为止的网格都不超过65536个顶点
+    int stride = 8;                             // 所有网格的stride必须一致
+    map<const GraphicObject*, MeshRange> shared_ranges;
+    vector<shared_ptr<const GraphicObject>> shared_meshes;
+};
+
+#endif // SCENEBUFFER_H
@@ -0,0 +1,247 @@
+#include "scenecache.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <cstring>
+
+// 结构体布局或写入顺序变化时加1
+const quint32 SCENE_CACHE_VERSION = 3;
+
+// 缓存目录的总大小上限, 超出时按最近使用的先后删除旧文件
+const qint64 SCENE_CACHE_LIMIT = qint64(2) << 30;
+
+struct SceneCacheHeader{
+    char magic[4];
+    quint32 version;
+    quint32 atom_instance_size;                 // 防止结构体布局变化后误读
+    quint32 bond_instance_size;
+    quint32 bvh_node_size;
+    quint32 path_length;
+    qint64 file_size;
+    qint64 file_mtime;
+    quint64 atom_count;
+    quint64 bond_count;
+    quint64 atom_instance_count;
+    quint64 bond_instance_count;
+    quint64 atom_node_count;
+    quint64 atom_index_count;
+    quint64 bond_node_count;
+    quint64 bond_index_count;
+    float lower[3];
+    float upper[3];
+    float center[3];
+};
+
+static void fill_Header(SceneCacheHeader& header, const QFileInfo& info){
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "MPVC", 4);
+    header.version = SCENE_CACHE_VERSION;
+    header.atom_instance_size = sizeof(AtomInstance);
+    header.bond_instance_size = sizeof(BondInstance);
+    header.bvh_node_size = sizeof(BvhNode);
+    header.path_length = info.absoluteFilePath().toUtf8().size();
+    header.file_size = info.size();
+    header.file_mtime = info.lastModified().toMSecsSinceEpoch();
+}
+
+QString scene_CachePath(const QString& path){
+    QFileInfo info(path);
+    if(!info.exists())
+        return QString();
+    // 只用路径做键: 文件改动或格式升级后原地覆盖同一个缓存, 大小/修改时间/版本由头部检查
+    QByteArray key = info.absoluteFilePath().toUtf8();
+    QString hash = QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex());
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/qtmpviewer";
+    return dir + "/" + hash + ".mpv";
+}
+
+template<class T>
+static bool write_Array(QSaveFile& file, const vector<T>& data){
+    qint64 bytes = qint64(data.size()*sizeof(T));
+    return bytes == 0 || file.write((const char*)data.data(), bytes) == bytes;
+}
+
+// 从映射区复制count个元素并前移p, 越界时返回false
+// count来自文件, 先按元素数比较, 避免count*sizeof(T)溢出后绕过检查
+template<class T>
+static bool read_Array(const char*& p, const char* end, quint64 count, vector<T>& data){
+    if(count > quint64(end-p) / sizeof(T))
+        return false;
+    quint64 bytes = count*sizeof(T);
+    data.resize(count);
+    if(bytes > 0)
+        memcpy(data.data(), p, bytes);
+    p += bytes;
+    return true;
+}
+
+// 原子/键的编号在着色器和CPU端都直接用作下标, 缓存中的值换入前逐一检查
+static bool valid_References(const AtomTable& atoms, const BondTable& bonds,
+                             const vector<AtomInstance>& atom_instances, const vector<BondInstance>& bond_instances){
+    size_t atom_count = atom_instances.size();
+    if(atoms.size() != atom_count)
+        return false;
+    for(size_t i = 0; i < bonds.size(); ++i){
+        if(bonds.first[i] >= atom_count || bonds.second[i] >= atom_count)
+            return false;
+    }
+    for(size_t i = 0; i < atom_count; ++i){
+        if(atom_instances[i].id != i)
+            return false;
+    }
+    for(size_t i = 0; i < bond_instances.size(); ++i){
+        const BondInstance& bond = bond_instances[i];
+        if(bond.first >= atom_count || bond.second >= atom_count || bond.id != i)
+            return false;
+    }
+    return true;
+}
+
+bool read_SceneCache(const QString& path, MolScene& scene){
+    QString cache_path = scene_CachePath(path);
+    if(cache_path.isEmpty())
+        return false;
+    QFile file(cache_path);
+    if(!file.open(QIODevice::ReadOnly) || file.size() < qint64(sizeof(SceneCacheHeader)))
+        return false;
+    const char* data = (const char*)file.map(0, file.size());
+    if(data == nullptr)
+        return false;
+    const char* end = data + file.size();
+
+    // 哈希只用来定位, 真正的键比较在这里
+    SceneCacheHeader header, expected;
+    memcpy(&header, data, sizeof(header));
+    QFileInfo info(path);
+    fill_Header(expected, info);
+    QByteArray absolute_path = info.absoluteFilePath().toUtf8();
+    if(memcmp(header.magic, expected.magic, 4) != 0 || header.version != expected.version ||
+       header.atom_instance_size != expected.atom_instance_size || header.bond_instance_size != expected.bond_instance_size ||
+       header.bvh_node_size != expected.bvh_node_size || header.path_length != expected.path_length ||
+       header.file_size != expected.file_size || header.file_mtime != expected.file_mtime)
+        return false;
+    const char* p = data + sizeof(header);
+    if(quint64(end-p) < header.path_length || memcmp(p, absolute_path.constData(), header.path_length) != 0)
+        return false;
+    p += header.path_length;
+
+    // 先读进局部变量, 全部成功后才换入scene; 缓存截断或损坏时scene保持原样, 调用者照常解析
+    AtomTable atoms;
+    BondTable bonds;
+    vector<AtomInstance> atom_instances;
+    vector<BondInstance> bond_instances;
+    vector<BvhNode> atom_nodes, bond_nodes;
+    vector<unsigned int> atom_indices, bond_indices;
+    bool ok = read_Array(p, end, header.atom_count, atoms.x) &&
+              read_Array(p, end, header.atom_count, atoms.y) &&
+              read_Array(p, end, header.atom_count, atoms.z) &&
+              read_Array(p, end, header.atom_count, atoms.atomic_number) &&
+              read_Array(p, end, header.atom_count, atoms.serial) &&
+              read_Array(p, end, header.atom_count, atoms.residue_seq) &&
+              read_Array(p, end, header.atom_count, atoms.residue_name) &&
+              read_Array(p, end, header.atom_count, atoms.chain) &&
+              read_Array(p, end, header.bond_count, bonds.first) &&
+              read_Array(p, end, header.bond_count, bonds.second) &&
+              read_Array(p, end, header.bond_count, bonds.order) &&
+              read_Array(p, end, header.atom_instance_count, atom_instances) &&
+              read_Array(p, end, header.bond_instance_count, bond_instances) &&
+              read_Array(p, end, header.atom_node_count, atom_nodes) &&
+              read_Array(p, end, header.atom_index_count, atom_indices) &&
+              read_Array(p, end, header.bond_node_count, bond_nodes) &&
+              read_Array(p, end, header.bond_index_count, bond_indices);
+    if(!ok || !valid_References(atoms, bonds, atom_instances, bond_instances))
+        return false;
+    Bvh atom_bvh, bond_bvh;
+    if(!atom_bvh.assign(atom_nodes, atom_indices, atom_instances.size()) ||
+       !bond_bvh.assign(bond_nodes, bond_indices, bond_instances.size()))
+        return false;
+
+    swap(scene.atom_table, atoms);
+    swap(scene.bond_table, bonds);
+    scene.atom_instances.swap(atom_instances);
+    scene.bond_instances.swap(bond_instances);
+    swap(scene.atom_bvh, atom_bvh);
+    swap(scene.bond_bvh, bond_bvh);
+    scene.lower = glm::vec3(header.lower[0], header.lower[1], header.lower[2]);
+    scene.upper = glm::vec3(header.upper[0], header.upper[1], header.upper[2]);
+    scene.center = glm::vec3(header.center[0], header.center[1], header.center[2]);
+    // 命中时刷新修改时间, prune_SceneCache按它判断最近使用
+    file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    return true;
+}
+
+// 从最近使用的文件开始累计大小, 超过上限后的旧文件删除; 刚写入的keep总是保留
+static void prune_SceneCache(const QString& dir_path, const QString& keep){
+    QFileInfoList files = QDir(dir_path).entryInfoList(QStringList() << "*.mpv", QDir::Files, QDir::Time);
+    qint64 total = 0;
+    for(const QFileInfo& file: files){
+        if(file.absoluteFilePath() != keep && total + file.size() > SCENE_CACHE_LIMIT)
+            QFile::remove(file.absoluteFilePath());
+        else
+            total += file.size();
+    }
+}
+
+bool write_SceneCache(const QString& path, const MolScene& scene){
+    QString cache_path = scene_CachePath(path);
+    if(cache_path.isEmpty() || !QDir().mkpath(QFileInfo(cache_path).absolutePath()))
+        return false;
+
+    SceneCacheHeader header;
+    QFileInfo info(path);
+    fill_Header(header, info);
+    const AtomTable& atoms = scene.atom_table;
+    const BondTable& bonds = scene.bond_table;
+    header.atom_count = atoms.size();
+    header.bond_count = bonds.size();
+    header.atom_instance_count = scene.atom_instances.size();
+    header.bond_instance_count = scene.bond_instances.size();
+    header.atom_node_count = scene.atom_bvh.getNodes().size();
+    header.atom_index_count = scene.atom_bvh.getIndices().size();
+    header.bond_node_count = scene.bond_bvh.getNodes().size();
+    header.bond_index_count = scene.bond_bvh.getIndices().size();
+    for(int i = 0; i < 3; ++i){
+        header.lower[i] = scene.lower[i];
+        header.upper[i] = scene.upper[i];
+        header.center[i] = scene.center[i];
+    }
+
+    // 先写临时文件再改名, 另一个进程不会读到写了一半的缓存
+    QSaveFile file(cache_path);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+    QByteArray absolute_path = info.absoluteFilePath().toUtf8();
+    bool ok = file.write((const char*)&header, sizeof(header)) == qint64(sizeof(header)) &&
+              file.write(absolute_path) == absolute_path.size() &&
+              write_Array(file, atoms.x) &&
+              write_Array(file, atoms.y) &&
+              write_Array(file, atoms.z) &&
+              write_Array(file, atoms.atomic_number) &&
+              write_Array(file, atoms.serial) &&
+              write_Array(file, atoms.residue_seq) &&
+              write_Array(file, atoms.residue_name) &&
+              write_Array(file, atoms.chain) &&
+              write_Array(file, bonds.first) &&
+              write_Array(file, bonds.second) &&
+              write_Array(file, bonds.order) &&
+              write_Array(file, scene.atom_instances) &&
+              write_Array(file, scene.bond_instances) &&
+              write_Array(file, scene.atom_bvh.getNodes()) &&
+              write_Array(file, scene.atom_bvh.getIndices()) &&
+              write_Array(file, scene.bond_bvh.getNodes()) &&
+              write_Array(file, scene.bond_bvh.getIndices());
+    if(!ok){
+        file.cancelWriting();
+        return false;
+    }
+    if(!file.commit())
+        return false;
+    prune_SceneCache(QFileInfo(cache_path).absolutePath(), QFileInfo(cache_path).absoluteFilePath());
+    return true;
+}
@@ -0,0 +1,22 @@
+#ifndef SCENECACHE_H
+#define SCENECACHE_H
+
+#include <QString>
+
+#include "molloader.h"
+
+// 载入结果的二进制缓存, 位于GenericCacheLocation/qtmpviewer/<hash>.mpv
+// 文件名是绝对路径的哈希, 头部记录大小/修改时间/格式版本, 任何一项不同都视为未命中, 重新写入时原地覆盖
+// 目录总大小超过SCENE_CACHE_LIMIT时按最近使用删除旧缓存
+// 缓存保存原子/键表, 实例(含芳香键的单双分配)和两棵BVH, 读入后无需再解析或构建
+
+// 该文件对应的缓存路径, 文件不存在时返回空字符串
+QString scene_CachePath(const QString& path);
+
+// 命中时填充scene(不含mol)并返回true
+bool read_SceneCache(const QString& path, MolScene& scene);
+
+// 写入失败(如缓存目录不可写)时返回false, 不影响正常显示
+bool write_SceneCache(const QString& path, const MolScene& scene);
+
+#endif // SCENECACHE_H
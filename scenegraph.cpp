@@ -0,0 +1,86 @@
+#include "scenegraph.h"
+
+#include <map>
+#include <tuple>
+
+void SceneGraph::build(const AtomTable& atoms){
+    clear();
+    nodes.push_back(SceneNode());               // 根节点: 整个分子
+
+    // 原子大多按链和残基连续排列, 先与上一个原子比较, 不同时再查表
+    map<char, unsigned int> chains;
+    map<tuple<char, int, array<char, 4>>, unsigned int> residues;
+    atom_node.resize(atoms.size());
+    int last_node = -1;
+    for(size_t i = 0; i < atoms.size(); ++i){
+        char chain = atoms.chain[i];
+        int seq = atoms.residue_seq[i];
+        const array<char, 4>& name = atoms.residue_name[i];
+        if(last_node >= 0){
+            const SceneNode& last = nodes[last_node];
+            if(last.chain == chain && last.residue_seq == seq && last.residue_name == name){
+                atom_node[i] = last_node;
+                continue;
+            }
+        }
+
+        auto residue = residues.find(make_tuple(chain, seq, name));
+        if(residue == residues.end()){
+            auto found = chains.find(chain);
+            if(found == chains.end()){
+                SceneNode node;
+                node.kind = NODE_CHAIN;
+                node.parent = 0;
+                node.chain = chain;
+                found = chains.insert(make_pair(chain, (unsigned int)nodes.size())).first;
+                nodes.push_back(node);
+            }
+            SceneNode node;
+            node.kind = NODE_RESIDUE;
+            node.parent = found->second;
+            node.chain = chain;
+            node.residue_seq = seq;
+            node.residue_name = name;
+            residue = residues.insert(make_pair(make_tuple(chain, seq, name), (unsigned int)nodes.size())).first;
+            nodes.push_back(node);
+        }
+        last_node = residue->second;
+        atom_node[i] = last_node;
+    }
+    dirty = false;
+}
+
+void SceneGraph::clear(){
+    nodes.clear();
+    atom_node.clear();
+    dirty = false;
+}
+
+void SceneGraph::setTransform(unsigned int node, const glm::mat4& local){
+    nodes[node].local = local;
+    nodes[node].dirty = true;
+    dirty = true;
+}
+
+bool SceneGraph::update(vector<unsigned char>& changed, size_t& first, size_t& last){
+    changed.assign(nodes.size(), 0);
+    first = nodes.size();
+    last = 0;
+    if(!dirty)
+        return false;
+
+    // 父节点总在前面, 它的世界矩阵变化时已经标记在changed中
+    for(size_t i = 0; i < nodes.size(); ++i){
+        SceneNode& node = nodes[i];
+        bool parent_changed = node.parent >= 0 && changed[node.parent];
+        if(!node.dirty && !parent_changed)
+            continue;
+        node.world = node.parent >= 0 ? nodes[node.parent].world * node.local : node.local;
+        node.dirty = false;
+        changed[i] = 1;
+        first = min(first, i);
+        last = i+1;
+    }
+    dirty = false;
+    return last > first;
+}
@@ -0,0 +1,66 @@
+#ifndef SCENEGRAPH_H
+#define SCENEGRAPH_H
+
+#include <array>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "moltable.h"
+
+using namespace std;
+
+// 场景图节点的层级
+enum SceneNodeKind{
+    NODE_MOLECULE,
+    NODE_CHAIN,
+    NODE_RESIDUE
+};
+
+// 节点按先父后子的顺序存放, parent总小于自身的下标, 顺序扫描一遍即可自上而下传播
+struct SceneNode{
+    SceneNodeKind kind = NODE_MOLECULE;
+    int parent = -1;
+    char chain = ' ';
+    int residue_seq = 0;
+    array<char, 4> residue_name = {{'\0', '\0', '\0', '\0'}};
+    glm::mat4 local = glm::mat4(1.0f);          // 相对父节点的变换
+    glm::mat4 world = glm::mat4(1.0f);
+    bool dirty = false;                         // local改过, 世界矩阵尚未更新
+};
+
+// 分子 -> 链 -> 残基三层变换节点; 原子是隐式的叶子, 只记录所挂的残基节点, 每个原子4字节
+// 原子坐标始终是节点内的局部坐标, 整条链或一个配体的刚体移动只改一个节点的矩阵,
+// 着色器按节点的世界矩阵变换位置流, 不必改动任何原子坐标或重新上传位置
+class SceneGraph{
+public:
+    SceneGraph() {}
+
+    // 按原子表的链和残基列建立节点, 同一链中(残基号, 残基名)相同的原子属于同一残基
+    void build(const AtomTable& atoms);
+    void clear();
+
+    void setTransform(unsigned int node, const glm::mat4& local);  // 只标记, update时再传播
+    const glm::mat4& getTransform(unsigned int node) const         { return nodes[node].local; }
+
+    // 从改过的节点向下重算世界矩阵, 只处理受影响的子树; changed[i]标记世界矩阵变了的节点,
+    // [first, last)是它们的下标范围, 供只上传这一段; 没有变化时返回false
+    bool update(vector<unsigned char>& changed, size_t& first, size_t& last);
+    bool isDirty() const                        { return dirty; }
+
+    size_t size() const                         { return nodes.size(); }
+    const SceneNode& getNode(unsigned int node) const   { return nodes[node]; }
+    unsigned int getAtomNode(size_t atom) const { return atom_node[atom]; }
+    const vector<unsigned int>& getAtomNodes() const    { return atom_node; }
+
+    // 原子的局部坐标变换到世界坐标
+    glm::vec3 toWorld(size_t atom, const glm::vec3& position) const {
+        return glm::vec3(nodes[atom_node[atom]].world * glm::vec4(position, 1.0f));
+    }
+
+private:
+    vector<SceneNode> nodes;
+    vector<unsigned int> atom_node;
+    bool dirty = false;
+};
+
+#endif // SCENEGRAPH_H
@@ -0,0 +1,69 @@
+#include "selection.h"
+
+void SelectionSet::resize(size_t count){
+    bit_count = count;
+    words.assign((count+31)/32, 0u);
+    dirty_first = 0;
+    dirty_last = words.size();
+}
+
+void SelectionSet::clear(){
+    resize(0);
+}
+
+bool SelectionSet::test(size_t index) const{
+    return (words[index >> 5] >> (index & 31)) & 1u;
+}
+
+void SelectionSet::set(size_t index, bool selected){
+    unsigned int bit = 1u << (index & 31);
+    unsigned int& word = words[index >> 5];
+    unsigned int value = selected ? (word | bit) : (word & ~bit);
+    if(value != word){
+        word = value;
+        mark(index >> 5);
+    }
+}
+
+void SelectionSet::toggle(size_t index){
+    words[index >> 5] ^= 1u << (index & 31);
+    mark(index >> 5);
+}
+
+void SelectionSet::setAll(bool selected){
+    if(words.empty())
+        return;
+    words.assign(words.size(), selected ? 0xFFFFFFFFu : 0u);
+    if(selected && (bit_count & 31))        // 末尾多余的位保持为0, count()才准确
+        words.back() = (1u << (bit_count & 31)) - 1;
+    dirty_first = 0;
+    dirty_last = words.size();
+}
+
+size_t SelectionSet::count() const{
+    size_t n = 0;
+    for(unsigned int word: words){
+        for(; word; word &= word-1)
+            ++n;
+    }
+    return n;
+}
+
+bool SelectionSet::takeDirty(size_t& first_word, size_t& last_word){
+    if(dirty_first >= dirty_last)
+        return false;
+    first_word = dirty_first;
+    last_word = dirty_last;
+    dirty_first = dirty_last = 0;
+    return true;
+}
+
+void SelectionSet::mark(size_t word){
+    if(dirty_first >= dirty_last){
+        dirty_first = word;
+        dirty_last = word+1;
+    }else{
+        if(word < dirty_first) dirty_first = word;
+        if(word+1 > dirty_last) dirty_last = word+1;
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#include <vector>
+#include <cstddef>
+
+using namespace std;
+
+// 原子选中状态的位集, 每个原子1 bit; 直接作为着色器中的Selection缓冲上传
+// 记录自上次上传以来被修改的字区间, 选中/取消只需上传变化的部分
+class SelectionSet{
+public:
+    SelectionSet() {}
+
+    void resize(size_t count);
+    void clear();
+
+    bool test(size_t index) const;
+    void set(size_t index, bool selected);
+    void toggle(size_t index);
+    void setAll(bool selected);
+    size_t count() const;
+    size_t size() const                         { return bit_count; }
+
+    // 取出并清空脏区间[first_word, last_word), 没有修改时返回false
+    bool takeDirty(size_t& first_word, size_t& last_word);
+    const vector<unsigned int>& getWords() const    { return words; }
+
+private:
+    void mark(size_t word);
+
+    vector<unsigned int> words;
+    size_t bit_count = 0;
+    size_t dirty_first = 0;
+    size_t dirty_last = 0;
+};
+
+#endif // SELECTION_H
@@ -11,6 +11,7 @@ Sphere::Sphere(int No, float radius, int sectors, int stacks, glm::vec3 position
         vertices[i*3 + 1] += position.y;
         vertices[i*3 + 2] += position.z;
     }
+    vertexOffset = position;
     buildInterleavedVertices();
 }
 
@@ -28,9 +29,14 @@ Sphere::Sphere(const Sphere &other){
     this->interleavedVertices = other.interleavedVertices;
     this->position = other.position;
     this->color = other.color;
+    this->vertexOffset = other.vertexOffset;
+    this->released = other.released;
+    this->releasedInfo = other.releasedInfo;
 };
 
 void Sphere::set(float radius, int sectors, int stacks, bool smooth){
+    this->released = false;
+    this->vertexOffset = glm::vec3(0.0f);
     this->radius = radius;
     this->sectorCount = sectors;
     if(sectors < MIN_SECTOR_COUNT)
@@ -70,6 +76,7 @@ void Sphere::setPosition(glm::vec3 new_position){
         vertices[i*3 + 1] += new_position.y;
         vertices[i*3 + 2] += new_position.z;
     }
+    vertexOffset += new_position;
     buildInterleavedVertices();
 };
 
@@ -100,6 +107,49 @@ void Sphere::printSelf() const{
          << "TexCoord Count: " << getTexCoordCount() << endl;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// GPU-resident mode: free every CPU array but keep the counts and bounds,
+// restoreArrays() regenerates the same vertices from radius/sectors/stacks
+///////////////////////////////////////////////////////////////////////////////
+void Sphere::releaseArrays(){
+    if(released)
+        return;
+    GeometryInfo info = getGeometryInfo();
+    clearArrays();
+    vector<float>().swap(interleavedVertices);
+    releasedInfo = info;
+    released = true;
+}
+
+void Sphere::restoreArrays(){
+    if(!released)
+        return;
+    glm::vec3 offset = vertexOffset;
+    set(radius, sectorCount, stackCount, smooth);
+    for(int i = 0; i < getVertexCount(); ++i){
+        vertices[i*3] += offset.x;
+        vertices[i*3 + 1] += offset.y;
+        vertices[i*3 + 2] += offset.z;
+    }
+    vertexOffset = offset;
+    buildInterleavedVertices();
+}
+
+GeometryInfo Sphere::getGeometryInfo() const{
+    if(released)
+        return releasedInfo;
+    GeometryInfo info;
+    info.vertexCount = getVertexCount();
+    info.indexCount = getIndexCount();
+    info.lineIndexCount = getLineIndexCount();
+    for(size_t i = 0; i + 2 < vertices.size(); i += 3){
+        glm::vec3 vertex(vertices[i], vertices[i+1], vertices[i+2]);
+        info.lower = i == 0 ? vertex : glm::min(info.lower, vertex);
+        info.upper = i == 0 ? vertex : glm::max(info.upper, vertex);
+    }
+    return info;
+}
+
 void Sphere::clearArrays(){
     vector<float>().swap(vertices);
     vector<float>().swap(normals);
@@ -34,11 +34,11 @@ public:
     void setSmooth(bool smooth);
 
     // for vertex data
-    unsigned int getVertexCount() const     { return (unsigned int)vertices.size() / 3; }
+    unsigned int getVertexCount() const     { return released ? releasedInfo.vertexCount : (unsigned int)vertices.size() / 3; }
     unsigned int getNormalCount() const     { return (unsigned int)normals.size() / 3; }
     unsigned int getTexCoordCount() const   { return (unsigned int)texCoords.size() / 2; }
-    unsigned int getIndexCount() const      { return (unsigned int)indices.size(); }
-    unsigned int getLineIndexCount() const  { return (unsigned int)lineIndices.size(); }
+    unsigned int getIndexCount() const      { return released ? releasedInfo.indexCount : (unsigned int)indices.size(); }
+    unsigned int getLineIndexCount() const  { return released ? releasedInfo.lineIndexCount : (unsigned int)lineIndices.size(); }
     unsigned int getTriangleCount() const   { return getIndexCount() / 3; }
     unsigned int getVertexSize() const      { return (unsigned int)vertices.size() * sizeof(float); }
     unsigned int getNormalSize() const      { return (unsigned int)normals.size() * sizeof(float); }
@@ -57,6 +57,12 @@ public:
     int getInterleavedStride() const                { return interleavedStride; }   // should be 32 bytes
     const float* getInterleavedVertices() const     { return interleavedVertices.data(); }
 
+    // GPU驻留模式
+    void releaseArrays();
+    void restoreArrays();
+    bool hasArrays() const                  { return !released; }
+    GeometryInfo getGeometryInfo() const;
+
     // debug
     void printSelf() const;
 
@@ -99,6 +105,11 @@ private:
     // position
     glm::vec3 position;
     glm::vec3 color;
+    glm::vec3 vertexOffset = glm::vec3(0.0f);  // 构造和setPosition累计加到顶点上的平移, 重新生成时再加一次
+
+    // 释放CPU数组后的计数和包围盒
+    bool released = false;
+    GeometryInfo releasedInfo;
 };
 
 #endif
@@ -0,0 +1,46 @@
+#version 420 core
+out vec4 FragColor;
+
+in vec3 ViewPos;
+flat in vec3 ViewCenter;
+flat in float Radius;
+flat in vec3 Color;
+
+void main()
+{
+    // ray from the eye (view space origin) through this fragment against the exact sphere
+    vec3 rayDir = normalize(ViewPos);
+    float b = dot(rayDir, ViewCenter);
+    float c = dot(ViewCenter, ViewCenter) - Radius * Radius;
+    float discriminant = b * b - c;
+    if(discriminant < 0.0)
+        discard;
+
+    vec3 hit = rayDir * (b - sqrt(discriminant));
+    vec3 norm = (hit - ViewCenter) / Radius;
+
+    vec4 clipPos = projection * vec4(hit, 1.0);
+    gl_FragDepth = 0.5 * (gl_DepthRange.diff * (clipPos.z / clipPos.w) + gl_DepthRange.near + gl_DepthRange.far);
+
+    // same Phong terms as instancedlighted.fs, evaluated in view space
+    vec3 lightViewPos = vec3(view * vec4(lightPos.xyz, 1.0));
+
+    // ambient
+    float ambientStrength = 0.1;
+    vec3 ambient = ambientStrength * lightColor.rgb;
+
+    // diffuse
+    vec3 lightDir = normalize(lightViewPos - hit);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = diff * lightColor.rgb;
+
+    // specular
+    float specularStrength = 0.5;
+    vec3 viewDir = normalize(-hit);
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+    vec3 specular = specularStrength * spec * lightColor.rgb;
+
+    vec3 result = (ambient + diffuse + specular) * Color;
+    FragColor = vec4(result, 1.0);
+}
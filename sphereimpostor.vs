@@ -0,0 +1,27 @@
+#version 430 core
+layout (location = 2) in vec4 aCenterRadius;
+layout (location = 3) in vec3 aColor;
+layout (location = 4) in uint aId;
+
+out vec3 ViewPos;
+flat out vec3 ViewCenter;
+flat out float Radius;
+flat out vec3 Color;
+flat out uint PickId;       // written to the ID buffer, see pickid.fs
+
+// quad corners of a triangle strip, indexed by gl_VertexID
+const vec2 corners[4] = vec2[4](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(-1.0, 1.0), vec2(1.0, 1.0));
+
+void main()
+{
+    ViewCenter = vec3(view * vec4(atomPosition(aId), 1.0));
+    Radius = aCenterRadius.w;
+    Color = selected(aId) ? vec3(1.0) : aColor;
+    PickId = aId + 1u;
+
+    // the quad faces the camera on the near side of the sphere and is enlarged
+    // so that the perspective silhouette always fits inside it
+    ViewPos = ViewCenter + vec3(corners[gl_VertexID] * Radius * 1.5, Radius);
+
+    gl_Position = projection * vec4(ViewPos, 1.0);
+}
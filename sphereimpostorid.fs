@@ -0,0 +1,24 @@
+#version 420 core
+// same silhouette and depth as sphereimpostor.fs, writing the pick id instead of the shaded color
+layout (location = 0) out uint FragId;
+
+in vec3 ViewPos;
+flat in vec3 ViewCenter;
+flat in float Radius;
+flat in uint PickId;
+
+void main()
+{
+    vec3 rayDir = normalize(ViewPos);
+    float b = dot(rayDir, ViewCenter);
+    float c = dot(ViewCenter, ViewCenter) - Radius * Radius;
+    float discriminant = b * b - c;
+    if(discriminant < 0.0)
+        discard;
+
+    vec3 hit = rayDir * (b - sqrt(discriminant));
+    vec4 clipPos = projection * vec4(hit, 1.0);
+    gl_FragDepth = 0.5 * (gl_DepthRange.diff * (clipPos.z / clipPos.w) + gl_DepthRange.near + gl_DepthRange.far);
+
+    FragId = PickId;
+}
@@ -0,0 +1,112 @@
+#include "threadpool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int thread_count): stopping(false), queued(0){
+    if(thread_count == 0)
+        thread_count = 1;
+    for(unsigned int i = 0; i < thread_count; ++i)
+        queues.push_back(unique_ptr<Queue>(new Queue));
+    for(unsigned int i = 0; i < thread_count; ++i)
+        workers.push_back(thread(&ThreadPool::work, this, i));
+}
+
+ThreadPool::~ThreadPool(){
+    {
+        lock_guard<mutex> guard(sleep_lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(thread& worker: workers)
+        worker.join();
+}
+
+ThreadPool& ThreadPool::instance(){
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, size_t grain, const function<void(size_t, size_t)>& body){
+    if(begin >= end)
+        return;
+    if(grain == 0)
+        grain = 1;
+    // 至少切成线程数的4倍, 让窃取有机会平衡负载
+    size_t n = end - begin;
+    grain = max<size_t>(1, min(grain, n/(4*workers.size())+1));
+    size_t chunks = (n + grain - 1)/grain;
+    if(chunks == 1){
+        body(begin, end);
+        return;
+    }
+
+    shared_ptr<atomic<size_t>> remaining = make_shared<atomic<size_t>>(chunks);
+    for(size_t c = 0; c < chunks; ++c){
+        size_t chunk_begin = begin + c*grain;
+        size_t chunk_end = min(end, chunk_begin + grain);
+        const function<void(size_t, size_t)>* fn = &body;
+        push((unsigned int)(c % queues.size()), [fn, chunk_begin, chunk_end, remaining](){
+            (*fn)(chunk_begin, chunk_end);
+            --(*remaining);
+        });
+    }
+    {
+        lock_guard<mutex> guard(sleep_lock);
+    }
+    wake.notify_all();
+
+    // 调用线程帮忙执行, 直到本次的所有块完成
+    Task task;
+    while(*remaining > 0){
+        if(pop((unsigned int)queues.size(), task))
+            task();
+        else
+            this_thread::yield();
+    }
+}
+
+void ThreadPool::push(unsigned int queue, Task task){
+    Queue& q = *queues[queue];
+    lock_guard<mutex> guard(q.lock);
+    q.tasks.push_back(std::move(task));
+    ++queued;
+}
+
+bool ThreadPool::pop(unsigned int queue, Task& task){
+    // 先取自己队列的队尾(缓存更热), 再依次窃取其它队列的队首
+    if(queue < queues.size()){
+        Queue& own = *queues[queue];
+        lock_guard<mutex> guard(own.lock);
+        if(!own.tasks.empty()){
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            --queued;
+            return true;
+        }
+    }
+    for(size_t i = 1; i <= queues.size(); ++i){
+        Queue& victim = *queues[(queue + i) % queues.size()];
+        lock_guard<mutex> guard(victim.lock);
+        if(!victim.tasks.empty()){
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            --queued;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::work(unsigned int index){
+    Task task;
+    while(true){
+        if(pop(index, task)){
+            task();
+            continue;
+        }
+        unique_lock<mutex> guard(sleep_lock);
+        wake.wait(guard, [this](){ return stopping || queued > 0; });
+        if(stopping && queued == 0)
+            return;
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+using namespace std;
+
+// 工作窃取线程池: 每个工作线程有自己的任务队列, 从队尾取自己的任务, 空闲时从其它队列的队首窃取
+// 调用parallelFor的线程也参与执行, 因此在任务中嵌套调用不会死锁
+class ThreadPool{
+public:
+    explicit ThreadPool(unsigned int thread_count = thread::hardware_concurrency());
+    ~ThreadPool();
+
+    static ThreadPool& instance();
+
+    // 把[begin, end)切成不大于grain的块并行执行body(chunk_begin, chunk_end), 全部完成后返回
+    // 每块写入各自预先分配好的输出区间, 不需要加锁
+    void parallelFor(size_t begin, size_t end, size_t grain, const function<void(size_t, size_t)>& body);
+
+    unsigned int getThreadCount() const         { return (unsigned int)workers.size(); }
+
+private:
+    typedef function<void()> Task;
+
+    struct Queue{
+        mutex lock;
+        deque<Task> tasks;
+    };
+
+    void push(unsigned int queue, Task task);
+    bool pop(unsigned int queue, Task& task);
+    void work(unsigned int index);
+
+    vector<unique_ptr<Queue>> queues;
+    vector<thread> workers;
+    atomic<bool> stopping;
+    atomic<unsigned int> queued;
+    mutex sleep_lock;
+    condition_variable wake;
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,16 @@
+#include "trajectory.h"
+
+#include <cstring>
+
+MemoryTrajectory::MemoryTrajectory(size_t atom_count, vector<float>& positions){
+    this->positions.swap(positions);
+    this->atom_count = atom_count;
+    this->frame_count = atom_count > 0 ? this->positions.size()/(3*atom_count) : 0;
+}
+
+bool MemoryTrajectory::readFrame(size_t frame, float* xyz){
+    if(frame >= frame_count)
+        return false;
+    memcpy(xyz, &positions[3*atom_count*frame], 3*atom_count*sizeof(float));
+    return true;
+}
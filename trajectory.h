@@ -0,0 +1,43 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <vector>
+#include <cstddef>
+
+using namespace std;
+
+// 轨迹: 拓扑不变, 只有原子坐标逐帧变化
+// 每帧按atom_instances的顺序存放x,y,z
+class Trajectory{
+public:
+    Trajectory() {}
+    virtual ~Trajectory() {}
+
+    size_t getAtomCount() const                 { return atom_count; }
+    size_t getFrameCount() const                { return frame_count; }
+
+    // 把第frame帧写入xyz(3*atom_count个float), 失败时返回false; 只在GUI线程中调用
+    virtual bool readFrame(size_t frame, float* xyz) = 0;
+
+protected:
+    size_t atom_count = 0;
+    size_t frame_count = 0;
+
+private:
+    Trajectory(const Trajectory&);
+    Trajectory& operator=(const Trajectory&);
+};
+
+// 所有帧都在内存中: 多MODEL的PDB, 多构象的分子, 帧0即载入时的原子位置
+class MemoryTrajectory: public Trajectory{
+public:
+    // 接管positions, 其长度应为3*atom_count的整数倍
+    MemoryTrajectory(size_t atom_count, vector<float>& positions);
+
+    bool readFrame(size_t frame, float* xyz);
+
+private:
+    vector<float> positions;
+};
+
+#endif // TRAJECTORY_H
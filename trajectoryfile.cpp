@@ -0,0 +1,614 @@
+#include "trajectoryfile.h"
+
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+///////////////////////////////////////////////////////////////////////////////
+// byte order helpers
+///////////////////////////////////////////////////////////////////////////////
+static uint32_t swap_Bytes(uint32_t value){
+    return (value >> 24) | ((value >> 8) & 0xff00u) | ((value << 8) & 0xff0000u) | (value << 24);
+}
+
+static uint32_t native_U32(const char* p){
+    uint32_t value;
+    memcpy(&value, p, 4);
+    return value;
+}
+
+static uint32_t big_U32(const char* p){
+    const unsigned char* u = (const unsigned char*)p;
+    return (uint32_t(u[0]) << 24) | (uint32_t(u[1]) << 16) | (uint32_t(u[2]) << 8) | uint32_t(u[3]);
+}
+
+static float big_Float(const char* p){
+    uint32_t bits = big_U32(p);
+    float value;
+    memcpy(&value, &bits, 4);
+    return value;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DCD (CHARMM/NAMD): Fortran unformatted records, fixed frame size
+///////////////////////////////////////////////////////////////////////////////
+class DcdFormat: public TrajectoryFormat{
+public:
+    bool buildIndex(QFile& file, size_t atom_count, vector<qint64>& offsets, QString* error);
+    bool decodeFrame(const char* data, size_t size, size_t atom_count, float* xyz) const;
+    bool persistIndex() const                   { return false; }
+
+private:
+    uint32_t word(const char* p) const          { return swapped ? swap_Bytes(native_U32(p)) : native_U32(p); }
+
+    bool swapped = false;                       // 文件的字节序与本机相反
+    bool has_cell = false;                      // CHARMM格式每帧前有一条晶胞记录(6个double)
+};
+
+bool DcdFormat::buildIndex(QFile& file, size_t atom_count, vector<qint64>& offsets, QString* error){
+    // 文件头: 84字节的控制记录, 标题记录, 原子数记录
+    char head[92];
+    if(!file.seek(0) || file.read(head, sizeof(head)) != qint64(sizeof(head))){
+        if(error) *error = QString("%1 is too short for a DCD file").arg(file.fileName());
+        return false;
+    }
+    if(native_U32(head) == 84)
+        swapped = false;
+    else if(swap_Bytes(native_U32(head)) == 84)
+        swapped = true;
+    else{
+        if(error) *error = QString("%1 is not a DCD file with 32-bit record markers").arg(file.fileName());
+        return false;
+    }
+    if(memcmp(head+4, "CORD", 4) != 0){
+        if(error) *error = QString("%1 is not a coordinate DCD file").arg(file.fileName());
+        return false;
+    }
+    uint32_t icntrl[20];
+    for(int i = 0; i < 20; ++i)
+        icntrl[i] = word(head+8+4*i);
+    bool charmm = icntrl[19] != 0;
+    has_cell = charmm && icntrl[10] != 0;
+    if(charmm && icntrl[11] != 0){
+        if(error) *error = QString("4D DCD files are not supported: %1").arg(file.fileName());
+        return false;
+    }
+    if(icntrl[8] != 0){
+        if(error) *error = QString("DCD files with fixed atoms are not supported: %1").arg(file.fileName());
+        return false;
+    }
+
+    qint64 pos = sizeof(head);
+    char marker[4];
+    if(!file.seek(pos) || file.read(marker, 4) != 4)
+        return false;
+    pos += 4 + word(marker) + 4;
+
+    char natom_record[12];
+    if(!file.seek(pos) || file.read(natom_record, 12) != 12){
+        if(error) *error = QString("%1 has no atom count record").arg(file.fileName());
+        return false;
+    }
+    size_t natom = word(natom_record+4);
+    if(natom != atom_count){
+        if(error) *error = QString("%1 has %2 atoms, the structure has %3").arg(file.fileName()).arg(natom).arg(atom_count);
+        return false;
+    }
+    pos += 12;
+
+    // NSET常常没有更新, 帧数按文件大小计算
+    qint64 frame_size = (has_cell ? 4+48+4 : 0) + 3*(4 + 4*qint64(natom) + 4);
+    qint64 frames = (file.size() - pos) / frame_size;
+    offsets.resize(frames+1);
+    for(qint64 i = 0; i <= frames; ++i)
+        offsets[i] = pos + i*frame_size;
+    return true;
+}
+
+bool DcdFormat::decodeFrame(const char* data, size_t size, size_t atom_count, float* xyz) const{
+    size_t p = has_cell ? 4+48+4 : 0;
+    if(size < p + 3*(8 + 4*atom_count))
+        return false;
+    // X, Y, Z各一条记录, 交错成xyz
+    for(int axis = 0; axis < 3; ++axis){
+        const char* values = data + p + 4;
+        for(size_t i = 0; i < atom_count; ++i){
+            uint32_t bits = word(values + 4*i);
+            memcpy(&xyz[3*i+axis], &bits, 4);
+        }
+        p += 8 + 4*atom_count;
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// XTC (GROMACS): XDR frames with the xdr3dfcoord compression
+// the bit stream is inherently serial; the decoder works on a 64-bit bit
+// buffer, splits packed integers with 64-bit division when they fit, and
+// leaves the int -> float scaling to a separate loop the compiler vectorizes
+///////////////////////////////////////////////////////////////////////////////
+static const int XTC_MAGIC = 1995;
+static const size_t XTC_HEADER = 56;            // magic, natoms, step, time, box[9], natoms
+static const size_t XTC_COMPRESSED_HEADER = 92; // + precision, minint[3], maxint[3], smallidx, byte count
+
+static const int MAGIC_INTS[] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 10, 12, 16, 20, 25, 32, 40, 50, 64,
+    80, 101, 128, 161, 203, 256, 322, 406, 512, 645, 812, 1024, 1290,
+    1625, 2048, 2580, 3250, 4096, 5060, 6501, 8192, 10321, 13003,
+    16384, 20642, 26007, 32768, 41285, 52015, 65536,
+    82570, 104031, 131072, 165140, 208063, 262144,
+    330280, 416127, 524287, 660561, 832255, 1048576, 1321122,
+    1664510, 2097152, 2642245, 3329021, 4194304, 5284491, 6658042,
+    8388607, 10568983, 13316085, 16777216
+};
+static const int FIRST_IDX = 9;
+static const int LAST_IDX = sizeof(MAGIC_INTS)/sizeof(MAGIC_INTS[0]);
+
+// 表示0..size-1所需的位数
+static int size_OfInt(unsigned int size){
+    unsigned int num = 1;
+    int bits = 0;
+    while(size >= num && bits < 32){
+        ++bits;
+        num <<= 1;
+    }
+    return bits;
+}
+
+// 三个整数按sizes混合进制打包后的位数
+static int size_OfInts(const unsigned int sizes[3]){
+    unsigned int bytes[32];
+    int num_of_bytes = 1;
+    bytes[0] = 1;
+    for(int i = 0; i < 3; ++i){
+        unsigned int tmp = 0;
+        int count;
+        for(count = 0; count < num_of_bytes; ++count){
+            tmp = bytes[count]*sizes[i] + tmp;
+            bytes[count] = tmp & 0xff;
+            tmp >>= 8;
+        }
+        while(tmp != 0){
+            bytes[count++] = tmp & 0xff;
+            tmp >>= 8;
+        }
+        num_of_bytes = count;
+    }
+    int bits = 0;
+    unsigned int num = 1;
+    --num_of_bytes;
+    while(bytes[num_of_bytes] >= num){
+        ++bits;
+        num *= 2;
+    }
+    return bits + num_of_bytes*8;
+}
+
+// 高位在前的位流, 一次补满64位缓冲
+struct XtcBits{
+    const unsigned char* p;
+    const unsigned char* end;
+    uint64_t cache = 0;
+    int count = 0;
+
+    XtcBits(const unsigned char* begin, const unsigned char* last): p(begin), end(last) {}
+
+    unsigned int read(int bits){                // bits <= 32
+        if(count < bits){
+            while(count <= 56){
+                cache = (cache << 8) | (p < end ? *p++ : 0);
+                count += 8;
+            }
+        }
+        count -= bits;
+        return (unsigned int)(cache >> count) & (unsigned int)((uint64_t(1) << bits) - 1);
+    }
+};
+
+// 读出bits位的打包整数, 低字节先到, 再按sizes拆成三个分量
+static void receive_Ints(XtcBits& stream, int bits, const unsigned int sizes[3], int nums[3]){
+    unsigned int bytes[32] = {0};
+    int num_of_bytes = 0;
+    while(bits > 8){
+        bytes[num_of_bytes++] = stream.read(8);
+        bits -= 8;
+    }
+    if(bits > 0)
+        bytes[num_of_bytes++] = stream.read(bits);
+
+    if(num_of_bytes <= 8){
+        uint64_t value = 0;
+        for(int j = num_of_bytes-1; j >= 0; --j)
+            value = (value << 8) | bytes[j];
+        nums[2] = int(value % sizes[2]);
+        value /= sizes[2];
+        nums[1] = int(value % sizes[1]);
+        nums[0] = int(value / sizes[1]);
+        return;
+    }
+
+    // 超过64位时逐字节做长除法
+    for(int i = 2; i > 0; --i){
+        unsigned int num = 0;
+        for(int j = num_of_bytes-1; j >= 0; --j){
+            num = (num << 8) | bytes[j];
+            unsigned int quotient = num / sizes[i];
+            bytes[j] = quotient;
+            num -= quotient*sizes[i];
+        }
+        nums[i] = int(num);
+    }
+    nums[0] = int(bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24));
+}
+
+// 解出atom_count个原子的整数坐标(乘过precision), 格式错误时返回false
+static bool decode_XtcInts(const unsigned char* data, size_t byte_count, size_t atom_count,
+                           const int minint[3], const int maxint[3], int smallidx, int* coords){
+    if(smallidx < FIRST_IDX || smallidx >= LAST_IDX)
+        return false;
+    unsigned int sizeint[3], bitsizeint[3] = {0, 0, 0};
+    for(int d = 0; d < 3; ++d)
+        sizeint[d] = unsigned(maxint[d] - minint[d]) + 1;
+    int bitsize;
+    if((sizeint[0] | sizeint[1] | sizeint[2]) > 0xffffff){
+        for(int d = 0; d < 3; ++d)
+            bitsizeint[d] = size_OfInt(sizeint[d]);
+        bitsize = 0;                            // 范围太大, 三个分量分别存放
+    }else{
+        bitsize = size_OfInts(sizeint);
+    }
+
+    int smaller = MAGIC_INTS[max(FIRST_IDX, smallidx-1)] / 2;
+    int smallnum = MAGIC_INTS[smallidx] / 2;
+    unsigned int sizesmall[3];
+    sizesmall[0] = sizesmall[1] = sizesmall[2] = MAGIC_INTS[smallidx];
+
+    XtcBits stream(data, data + byte_count);
+    int* out = coords;
+    int* out_end = coords + 3*atom_count;
+    size_t i = 0;
+    int run = 0;
+    int thiscoord[3], prevcoord[3];
+    while(i < atom_count){
+        if(bitsize == 0){
+            for(int d = 0; d < 3; ++d)
+                thiscoord[d] = stream.read(bitsizeint[d]);
+        }else{
+            receive_Ints(stream, bitsize, sizeint, thiscoord);
+        }
+        ++i;
+        for(int d = 0; d < 3; ++d){
+            thiscoord[d] += minint[d];
+            prevcoord[d] = thiscoord[d];
+        }
+
+        int is_smaller = 0;
+        if(stream.read(1) == 1){
+            run = stream.read(5);
+            is_smaller = run % 3;
+            run -= is_smaller;
+            --is_smaller;
+        }
+        if(run > 0){
+            // 一串相邻原子相对前一个原子小幅编码
+            if(out + 3 + run > out_end)
+                return false;
+            for(int k = 0; k < run; k += 3){
+                receive_Ints(stream, smallidx, sizesmall, thiscoord);
+                ++i;
+                for(int d = 0; d < 3; ++d)
+                    thiscoord[d] += prevcoord[d] - smallnum;
+                if(k == 0){
+                    // 编码时交换了前两个原子(利于水分子), 这里换回来
+                    for(int d = 0; d < 3; ++d)
+                        swap(thiscoord[d], prevcoord[d]);
+                    for(int d = 0; d < 3; ++d)
+                        *out++ = prevcoord[d];
+                }else{
+                    for(int d = 0; d < 3; ++d)
+                        prevcoord[d] = thiscoord[d];
+                }
+                for(int d = 0; d < 3; ++d)
+                    *out++ = thiscoord[d];
+            }
+        }else{
+            if(out + 3 > out_end)
+                return false;
+            for(int d = 0; d < 3; ++d)
+                *out++ = thiscoord[d];
+        }
+
+        smallidx += is_smaller;
+        if(smallidx < FIRST_IDX || smallidx >= LAST_IDX)
+            return false;
+        if(is_smaller < 0){
+            smallnum = smaller;
+            smaller = smallidx > FIRST_IDX ? MAGIC_INTS[smallidx-1] / 2 : 0;
+        }else if(is_smaller > 0){
+            smaller = smallnum;
+            smallnum = MAGIC_INTS[smallidx] / 2;
+        }
+        sizesmall[0] = sizesmall[1] = sizesmall[2] = MAGIC_INTS[smallidx];
+    }
+    return out == out_end;
+}
+
+class XtcFormat: public TrajectoryFormat{
+public:
+    bool buildIndex(QFile& file, size_t atom_count, vector<qint64>& offsets, QString* error);
+    bool decodeFrame(const char* data, size_t size, size_t atom_count, float* xyz) const;
+};
+
+bool XtcFormat::buildIndex(QFile& file, size_t atom_count, vector<qint64>& offsets, QString* error){
+    // 逐帧只读帧头, 按压缩数据的字节数跳到下一帧; 结果会保存下来, 只在第一次打开时扫描
+    qint64 size = file.size();
+    qint64 pos = 0;
+    char header[XTC_COMPRESSED_HEADER];
+    while(pos < size){
+        qint64 got = file.seek(pos) ? file.read(header, sizeof(header)) : -1;
+        if(got < qint64(XTC_HEADER) || int(big_U32(header)) != XTC_MAGIC)
+            break;
+        size_t natoms = big_U32(header+4);
+        if(natoms != atom_count){
+            if(error) *error = QString("%1 has %2 atoms, the structure has %3").arg(file.fileName()).arg(natoms).arg(atom_count);
+            return false;
+        }
+        qint64 frame_size;
+        if(natoms <= 9){
+            frame_size = XTC_HEADER + 12*natoms;
+        }else{
+            if(got < qint64(XTC_COMPRESSED_HEADER))
+                break;
+            qint64 byte_count = big_U32(header+88);
+            frame_size = XTC_COMPRESSED_HEADER + ((byte_count+3) & ~qint64(3));
+        }
+        if(pos + frame_size > size)
+            break;                              // 写了一半的最后一帧
+        offsets.push_back(pos);
+        pos += frame_size;
+    }
+    if(offsets.empty()){
+        if(error) *error = QString("%1 is not an XTC file").arg(file.fileName());
+        return false;
+    }
+    offsets.push_back(pos);
+    return true;
+}
+
+bool XtcFormat::decodeFrame(const char* data, size_t size, size_t atom_count, float* xyz) const{
+    if(size < XTC_HEADER || int(big_U32(data)) != XTC_MAGIC || big_U32(data+4) != atom_count)
+        return false;
+    // XTC以纳米为单位
+    if(atom_count <= 9){
+        if(size < XTC_HEADER + 12*atom_count)
+            return false;
+        for(size_t k = 0; k < 3*atom_count; ++k)
+            xyz[k] = 10.0f*big_Float(data + XTC_HEADER + 4*k);
+        return true;
+    }
+
+    if(size < XTC_COMPRESSED_HEADER)
+        return false;
+    float precision = big_Float(data+56);
+    int minint[3], maxint[3];
+    for(int d = 0; d < 3; ++d){
+        minint[d] = int(big_U32(data+60+4*d));
+        maxint[d] = int(big_U32(data+72+4*d));
+    }
+    int smallidx = int(big_U32(data+84));
+    size_t byte_count = big_U32(data+88);
+    if(precision <= 0.0f || XTC_COMPRESSED_HEADER + byte_count > size)
+        return false;
+
+    vector<int> coords(3*atom_count);
+    if(!decode_XtcInts((const unsigned char*)data + XTC_COMPRESSED_HEADER, byte_count, atom_count, minint, maxint, smallidx, coords.data()))
+        return false;
+    const float scale = 10.0f/precision;
+    const int* source = coords.data();
+    for(size_t k = 0; k < 3*atom_count; ++k)
+        xyz[k] = source[k]*scale;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FileTrajectory
+///////////////////////////////////////////////////////////////////////////////
+struct FrameIndexHeader{
+    char magic[4];
+    quint32 version;
+    qint64 file_size;
+    qint64 file_mtime;
+    quint64 atom_count;
+    quint64 frame_count;
+};
+
+FileTrajectory::FileTrajectory(TrajectoryFormat* format): format(format){
+}
+
+FileTrajectory::~FileTrajectory(){
+    {
+        lock_guard<mutex> guard(prefetch_lock);
+        stopping = true;
+    }
+    prefetch_wake.notify_all();
+    if(prefetcher.joinable())
+        prefetcher.join();
+}
+
+bool FileTrajectory::open(const QString& path, size_t atom_count, QString* error){
+    this->path = path;
+    this->atom_count = atom_count;
+    QFileInfo info(path);
+    file_size = info.size();
+    file_mtime = info.lastModified().toMSecsSinceEpoch();
+    file.setFileName(path);
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)){
+        if(error) *error = QString("cannot open %1").arg(path);
+        return false;
+    }
+
+    QString index_path = path + ".mpvidx";
+    if(!format->persistIndex() || !load_Index(index_path)){
+        offsets.clear();
+        if(!format->buildIndex(file, atom_count, offsets, error))
+            return false;
+        if(format->persistIndex())
+            save_Index(index_path);
+    }
+    if(offsets.size() < 2){
+        if(error) *error = QString("%1 contains no complete frame").arg(path);
+        return false;
+    }
+    frame_count = offsets.size()-1;
+
+    prefetcher = thread(&FileTrajectory::prefetch_Loop, this);
+    return true;
+}
+
+bool FileTrajectory::load_Index(const QString& index_path){
+    // 轨迹文件的大小或修改时间变了(例如模拟还在追加)就重新扫描
+    QFile index(index_path);
+    FrameIndexHeader header;
+    if(!index.open(QIODevice::ReadOnly) || index.read((char*)&header, sizeof(header)) != qint64(sizeof(header)))
+        return false;
+    if(memcmp(header.magic, "MPVI", 4) != 0 || header.version != 1 || header.file_size != file_size ||
+       header.file_mtime != file_mtime || header.atom_count != atom_count)
+        return false;
+    // 每帧至少一个字节, 帧数不会超过轨迹文件的长度; 索引本身也必须恰好装下这么多偏移
+    quint64 stored = quint64(index.size() - qint64(sizeof(header))) / sizeof(qint64);
+    if(header.frame_count > quint64(file_size) || header.frame_count+1 != stored)
+        return false;
+    offsets.resize(header.frame_count+1);
+    qint64 bytes = qint64(offsets.size()*sizeof(qint64));
+    if(index.read((char*)offsets.data(), bytes) != bytes)
+        return false;
+
+    // 偏移严格递增且都在文件之内, 否则load_Frame会算出负的或超长的帧; 不合法时调用者重新扫描
+    bool valid = offsets[0] >= 0 && offsets.back() <= file_size;
+    for(size_t i = 1; valid && i < offsets.size(); ++i)
+        valid = offsets[i] > offsets[i-1];
+    if(!valid)
+        offsets.clear();
+    return valid;
+}
+
+void FileTrajectory::save_Index(const QString& index_path) const{
+    // 轨迹所在目录不可写时放弃保存, 下次打开重新扫描
+    // 先写临时文件, 全部写完才改名, 中断的写入不会留下截断的索引
+    QSaveFile index(index_path);
+    if(!index.open(QIODevice::WriteOnly))
+        return;
+    FrameIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "MPVI", 4);
+    header.version = 1;
+    header.file_size = file_size;
+    header.file_mtime = file_mtime;
+    header.atom_count = atom_count;
+    header.frame_count = offsets.size()-1;
+    qint64 bytes = qint64(offsets.size()*sizeof(qint64));
+    bool ok = index.write((const char*)&header, sizeof(header)) == qint64(sizeof(header)) &&
+              index.write((const char*)offsets.data(), bytes) == bytes;
+    if(!ok){
+        index.cancelWriting();
+        return;
+    }
+    index.commit();
+}
+
+bool FileTrajectory::load_Frame(QFile& source, vector<char>& buffer, size_t frame, float* xyz) const{
+    qint64 size = offsets[frame+1] - offsets[frame];
+    buffer.resize(size);
+    if(!source.seek(offsets[frame]) || source.read(buffer.data(), size) != size)
+        return false;
+    return format->decodeFrame(buffer.data(), size, atom_count, xyz);
+}
+
+bool FileTrajectory::readFrame(size_t frame, float* xyz){
+    if(frame >= frame_count)
+        return false;
+    bool hit = false;
+    {
+        lock_guard<mutex> guard(prefetch_lock);
+        auto cached = prefetched.find(frame);
+        if(cached != prefetched.end()){
+            memcpy(xyz, cached->second.data(), 3*atom_count*sizeof(float));
+            hit = true;
+        }
+    }
+    if(!hit && !load_Frame(file, bytes, frame, xyz))
+        return false;
+    request_Prefetch((frame+1) % frame_count);
+    return true;
+}
+
+void FileTrajectory::request_Prefetch(size_t first){
+    // 新窗口之外的帧不再需要; 循环播放时窗口跨过最后一帧回到开头
+    size_t window = min(PREFETCH_FRAMES, frame_count);
+    {
+        lock_guard<mutex> guard(prefetch_lock);
+        prefetch_first = first;
+        prefetch_pending = true;
+        for(auto i = prefetched.begin(); i != prefetched.end();){
+            if((i->first + frame_count - first) % frame_count >= window)
+                i = prefetched.erase(i);
+            else
+                ++i;
+        }
+    }
+    prefetch_wake.notify_one();
+}
+
+void FileTrajectory::prefetch_Loop(){
+    QFile source(path);
+    if(!source.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+        return;
+    vector<char> buffer;
+    vector<float> xyz;
+    size_t window = min(PREFETCH_FRAMES, frame_count);
+
+    unique_lock<mutex> guard(prefetch_lock);
+    while(true){
+        prefetch_wake.wait(guard, [this](){ return stopping || prefetch_pending; });
+        if(stopping)
+            return;
+        prefetch_pending = false;
+        for(size_t k = 0; k < window; ++k){
+            size_t frame = (prefetch_first + k) % frame_count;
+            if(prefetched.count(frame))
+                continue;
+            // 读盘和解码时不持锁, GUI线程可以同时取已缓存的帧
+            guard.unlock();
+            xyz.resize(3*atom_count);
+            bool ok = load_Frame(source, buffer, frame, xyz.data());
+            guard.lock();
+            if(stopping)
+                return;
+            if(ok && (frame + frame_count - prefetch_first) % frame_count < window)
+                prefetched[frame].swap(xyz);
+            if(!ok || prefetch_pending)
+                break;                          // 窗口已经移动, 从新的位置重新开始
+        }
+    }
+}
+
+shared_ptr<Trajectory> open_Trajectory(const QString& path, size_t atom_count, QString* error){
+    QString suffix = QFileInfo(path).suffix().toLower();
+    TrajectoryFormat* format = nullptr;
+    if(suffix == "dcd")
+        format = new DcdFormat;
+    else if(suffix == "xtc")
+        format = new XtcFormat;
+    else{
+        if(error) *error = QString("unsupported trajectory format: %1").arg(path);
+        return shared_ptr<Trajectory>();
+    }
+    shared_ptr<FileTrajectory> trajectory = make_shared<FileTrajectory>(format);
+    if(!trajectory->open(path, atom_count, error))
+        return shared_ptr<Trajectory>();
+    return trajectory;
+}
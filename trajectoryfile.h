@@ -0,0 +1,72 @@
+#ifndef TRAJECTORYFILE_H
+#define TRAJECTORYFILE_H
+
+#include <QFile>
+#include <QString>
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "trajectory.h"
+
+using namespace std;
+
+// 轨迹文件的格式: 建立帧偏移索引, 解码单帧
+// decodeFrame只读成员, GUI线程和预读线程会同时调用
+class TrajectoryFormat{
+public:
+    virtual ~TrajectoryFormat() {}
+
+    // 扫描文件得到每帧的起始偏移, offsets比帧数多一项(最后一帧的结尾)
+    virtual bool buildIndex(QFile& file, size_t atom_count, vector<qint64>& offsets, QString* error) = 0;
+    // 把一帧的原始字节解码为xyz(埃)
+    virtual bool decodeFrame(const char* data, size_t size, size_t atom_count, float* xyz) const = 0;
+    // 偏移能直接算出的格式不必保存索引, 但每次打开都要调用buildIndex读文件头
+    virtual bool persistIndex() const           { return true; }
+};
+
+// 每次读帧后在后台预读的帧数
+const size_t PREFETCH_FRAMES = 8;
+
+// 按帧偏移随机读取的轨迹文件: 首次打开时建立索引并保存为<file>.mpvidx, 文件未变时直接读入
+// readFrame只seek并读一帧; 后台线程预读其后的PREFETCH_FRAMES帧, 顺序播放时几乎总是命中
+class FileTrajectory: public Trajectory{
+public:
+    explicit FileTrajectory(TrajectoryFormat* format);     // 接管format
+    ~FileTrajectory();
+
+    bool open(const QString& path, size_t atom_count, QString* error = nullptr);
+    bool readFrame(size_t frame, float* xyz);
+
+private:
+    bool load_Index(const QString& index_path);
+    void save_Index(const QString& index_path) const;
+    bool load_Frame(QFile& source, vector<char>& bytes, size_t frame, float* xyz) const;
+    void request_Prefetch(size_t first);
+    void prefetch_Loop();
+
+    unique_ptr<TrajectoryFormat> format;
+    QString path;
+    qint64 file_size = 0;
+    qint64 file_mtime = 0;
+    vector<qint64> offsets;
+    QFile file;                                 // 只在GUI线程中使用, 预读线程有自己的QFile
+    vector<char> bytes;
+
+    thread prefetcher;
+    mutex prefetch_lock;
+    condition_variable prefetch_wake;
+    bool stopping = false;
+    bool prefetch_pending = false;
+    size_t prefetch_first = 0;                  // 希望缓存的帧为[prefetch_first, prefetch_first+PREFETCH_FRAMES)
+    map<size_t, vector<float>> prefetched;
+};
+
+// 按后缀(.dcd/.xtc)打开轨迹, 原子数必须与当前结构一致
+shared_ptr<Trajectory> open_Trajectory(const QString& path, size_t atom_count, QString* error = nullptr);
+
+#endif // TRAJECTORYFILE_H